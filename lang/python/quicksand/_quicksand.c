@@ -32,6 +32,10 @@ static void *lib_handle = NULL;
 static int64_t (*p_quicksand_connect)(quicksand_connection **,
 				      char *, int64_t, int64_t,
 				      int64_t, void *) = NULL;
+static int64_t (*p_quicksand_connect_options)(quicksand_connection **,
+					      char *, int64_t, int64_t,
+					      int64_t, quicksand_options *,
+					      void *) = NULL;
 static void (*p_quicksand_disconnect)(quicksand_connection **,
 				      void *) = NULL;
 static void (*p_quicksand_delete)(char *, int64_t) = NULL;
@@ -79,27 +83,31 @@ py_quicksand_connect(PyObject *self, PyObject *args, PyObject *kwds)
 	static const char *kwlist[] = {"topic",
 				       "message_size",
 				       "message_rate",
+				       "ring_length",
 				       NULL};
 
 	const char *topic;
 	Py_ssize_t topic_len = -1; /* will stay -1 (NUL‑terminated) */
 	int64_t msg_sz = -1,
 		msg_rate = -1;
+	quicksand_options options = {0};
 	quicksand_connection *conn = NULL;
 	int64_t rc;
 
 	if(!PyArg_ParseTupleAndKeywords(args, kwds,
-					"s|LL", kwlist,
-					&topic, &msg_sz, &msg_rate)) {
+					"s|LLL", kwlist,
+					&topic, &msg_sz, &msg_rate,
+					&options.ring_length)) {
 		return NULL;
 	}
 
-	rc = p_quicksand_connect(&conn,
-				 (char *) topic,
-				 (int64_t) topic_len,
-				 msg_sz,
-				 msg_rate,
-				 NULL); /* alloc = NULL => stdlib malloc */
+	rc = p_quicksand_connect_options(&conn,
+					 (char *) topic,
+					 (int64_t) topic_len,
+					 msg_sz,
+					 msg_rate,
+					 &options,
+					 NULL); /* alloc = NULL => stdlib malloc */
 
 	if(rc < 0) {
 		PyErr_Format(PyExc_RuntimeError,
@@ -235,20 +243,13 @@ _py_quicksand_read(PyObject *self, PyObject *args, int latest)
 	msg_sz = (int64_t) view.len;
 
 	// if latest, read only the latest available message if available
-	if(latest) {
-		if(conn->read_index < conn->buffer->index) {
-			conn->read_index = conn->buffer->index - 1;
-			rc = p_quicksand_read(conn,
-					      (uint8_t *) view.buf,
-					      &msg_sz);
-		} else {
-			rc = -1;
-		}
-	} else {
-		rc = p_quicksand_read(conn,
-				      (uint8_t *) view.buf,
-				      &msg_sz);
+	if(latest && conn->read_index < conn->buffer->index) {
+		conn->read_index = conn->buffer->index - 1;
 	}
+	/* (reading when caught up also follows a grown topic) */
+	rc = p_quicksand_read(conn,
+			      (uint8_t *) view.buf,
+			      &msg_sz);
 
 
 	PyBuffer_Release(&view);
@@ -435,6 +436,9 @@ PyInit__quicksand(void)
 	if(load_symbol("quicksand_connect", (void **) &p_quicksand_connect) < 0) {
 		return NULL;
 	}
+	if(load_symbol("quicksand_connect_options", (void **) &p_quicksand_connect_options) < 0) {
+		return NULL;
+	}
 	if(load_symbol("quicksand_disconnect", (void **) &p_quicksand_disconnect) < 0) {
 		return NULL;
 	}
@@ -18,13 +18,15 @@ class Connection:
 
     def __init__(self, topic: str,
                  message_size: int = -1,
-                 message_rate: int = -1):
+                 message_rate: int = -1,
+                 ring_length: int = 0):
         """
-        Create a connection (calls quicksand_connect).
+        Create a connection (calls quicksand_connect_options).
 
         :param topic: name of the shared memory segment.
         :param message_size: maximum bytes per message, -1 = read from existing.
         :param message_rate: max msgs/sec, -1 = read from existing.
+        :param ring_length: ring slots, 0 = one second of message_rate.
         """
         self.topic = topic
         self.rate = message_rate
@@ -32,6 +34,7 @@ class Connection:
             topic,
             message_size=message_size,
             message_rate=message_rate,
+            ring_length=ring_length,
         )
 
     def close(self) -> None:
@@ -8,21 +8,119 @@ extern "C" {
 #include <stdint.h>
 
 #define CACHE_LINE_SIZE 64
+// Shared header lines are padded to pairs of cache lines: the adjacent-line
+// prefetcher pulls lines in 128 byte pairs, which would otherwise couple
+// unrelated fields.
+#define QUICKSAND_LINE (2 * CACHE_LINE_SIZE)
 
-// Quicksand ring buffer data struct
+// Segment format.  A segment starts with the magic number, the header
+// layout version and two feature bitmasks.  Connecting fails when the
+// magic or version differ, or when the segment uses an incompatible
+// feature this build does not know; unknown compatible features are
+// ignored.
+#define QUICKSAND_MAGIC 0x444e41534b495551ull // "QUIKSAND"
+#define QUICKSAND_VERSION 3		      // Shared header layout
+#define QUICKSAND_COMPAT_SYNC (1ull << 0)     // Writers sync a file-backed topic
+#define QUICKSAND_COMPAT_TYPE (1ull << 1)     // Topic carries a payload type hash
+#define QUICKSAND_COMPAT_KNOWN (QUICKSAND_COMPAT_SYNC | QUICKSAND_COMPAT_TYPE) // Understood
+#define QUICKSAND_INCOMPAT_ALIAS (1ull << 0)  // Segment only names another topic
+#define QUICKSAND_INCOMPAT_KNOWN QUICKSAND_INCOMPAT_ALIAS // Incompatible features understood
+#define QUICKSAND_ALIAS_HOPS 8 // Longest chain of aliases followed on connect
+#define QUICKSAND_MAX_PEERS 32 // Connections tracked per topic
+
+// Durability of file-backed topics (quicksand_options.sync)
+#define QUICKSAND_SYNC_NONE 0	   // Kernel write-back (survives crashes)
+#define QUICKSAND_SYNC_MSYNC 1	   // msync the written slot on every write
+#define QUICKSAND_SYNC_FDATASYNC 2 // fdatasync the file on every write
+
+// Peer roles (bitmask)
+#define QUICKSAND_ROLE_READER 1	  // Connected without creating the topic
+#define QUICKSAND_ROLE_WRITER 2	  // Created the topic or has written
+#define QUICKSAND_ROLE_RELIABLE 4 // Registered reader, holds writers back
+
+// Writer backpressure policies (used when a registered reader would be lapped)
+#define QUICKSAND_LOSSY 0 // Ignore registered readers (overwrite)
+#define QUICKSAND_BLOCK 1 // Wait for the slowest reader (until timeout)
+#define QUICKSAND_FAIL 2  // Return -EAGAIN immediately
+#define QUICKSAND_SPILL 3 // Queue in the writer's side buffer, flush later
+
+// Connected reader/writer entry (one line pair per peer)
+typedef struct {
+	volatile _Atomic(uint64_t) state;		   // 0 free, 1 claiming, 2 active
+	volatile _Atomic(uint64_t) cursor;		   // Next index to be read
+	volatile _Atomic(uint64_t) tick;		   // Last activity timestamp
+	volatile _Atomic(uint64_t) role;		   // QUICKSAND_ROLE_* bits
+	uint64_t pid;					   // Owning process id
+	volatile _Atomic(uint64_t) lag;			   // Max unread slots seen
+	char pad[QUICKSAND_LINE - 6 * sizeof(uint64_t)];   //
+} quicksand_peer;
+
+// Clock calibration shared by every process using a topic (seqlock)
 typedef struct {
+	volatile _Atomic(uint64_t) sequence;		   // Odd while being updated
+	uint64_t ns_scale;				   // Fixed-point [shift][mult]
+	double ns_per_tick;				   // Nanoseconds per tick
+	uint64_t tick;					   // Reference timestamp
+	uint64_t monotonic_ns;				   // CLOCK_MONOTONIC at tick
+	uint64_t realtime_ns;				   // CLOCK_REALTIME at tick
+	volatile _Atomic(uint64_t) claimed;		   // CLOCK_MONOTONIC an update began
+	char pad[QUICKSAND_LINE - 7 * sizeof(uint64_t)];   //
+} quicksand_clock;
+
+// Quicksand ring buffer data struct.  Each line pair has one job so that
+// polling readers, reserving writers and publishing writers do not share:
+//   geometry (read-mostly) | reserve | index (publish) | lock + timestamp |
+//   cached slowest reader  | shared clock | peers
+typedef struct {
+	volatile _Atomic(uint64_t) magic;		   // QUICKSAND_MAGIC once ready
+	uint64_t version;				   // QUICKSAND_VERSION
+	uint64_t compat;				   // Features older peers may ignore
+	uint64_t incompat;				   // Features peers must understand
 	uint64_t length;				   // Number of slots
 	uint64_t message_size;				   // Size (bytes) of slot
-	char pad1[CACHE_LINE_SIZE - 2 * sizeof(int64_t)];  //
+	uint64_t generation;				   // Times the topic has grown
+	volatile _Atomic(uint64_t) successor;		   // Replacement generation
+	uint64_t sync;					   // QUICKSAND_SYNC_* (files)
+	volatile _Atomic(uint64_t) boot;		   // Boot a file was last used in
+	uint64_t type;					   // Payload type hash (0 untyped)
+	char pad1[QUICKSAND_LINE - 11 * sizeof(int64_t)];  //
 	volatile _Atomic(uint64_t) reserve;		   // Writer reserve index
-	char pad2[CACHE_LINE_SIZE - sizeof(uint64_t)];	   //
+	char pad2[QUICKSAND_LINE - sizeof(uint64_t)];	   //
 	volatile _Atomic(uint64_t) index;		   // Ring current head
+	volatile _Atomic(uint64_t) waiters;		   // Sleeping on index
+	char pad3[QUICKSAND_LINE - 2 * sizeof(uint64_t)];  //
 	volatile _Atomic(uint64_t) updatestamp;		   // Last update timestamp
 	volatile _Atomic(uint64_t) locked;		   // Write timeout stamp
-	char pad3[CACHE_LINE_SIZE - 3 * sizeof(uint64_t)]; //
+	char pad4[QUICKSAND_LINE - 2 * sizeof(uint64_t)];  //
+	volatile _Atomic(uint64_t) min_cursor;		   // Cached slowest reader
+	char pad5[QUICKSAND_LINE - sizeof(uint64_t)];	   //
+	quicksand_clock clock;				   // Shared calibration
+	quicksand_peer peers[QUICKSAND_MAX_PEERS];	   // Connection registry
 } quicksand_ringbuffer;
 // char data[]  // (DATA STORED IN SHM AFTER BUFFER)
 
+// Alias segment: the format line of a ring (no slots) and the name of the
+// topic it stands for.  Smaller than any ring, so its size identifies it.
+typedef struct {
+	volatile _Atomic(uint64_t) magic;		   // QUICKSAND_MAGIC once ready
+	uint64_t version;				   // QUICKSAND_VERSION
+	uint64_t compat;				   // Features older peers may ignore
+	uint64_t incompat;				   // QUICKSAND_INCOMPAT_ALIAS
+	char pad[QUICKSAND_LINE - 4 * sizeof(uint64_t)];   //
+	char target[256];				   // Topic name (or another alias)
+} quicksand_alias_segment;
+
+// Log-linear latency histogram (HDR-style): values below 64 ticks are
+// exact, larger ones keep 5 significant bits (about 3% resolution)
+#define QUICKSAND_HISTOGRAM_SUB_BITS 5
+#define QUICKSAND_HISTOGRAM_BUCKETS ((64 - QUICKSAND_HISTOGRAM_SUB_BITS + 1) << QUICKSAND_HISTOGRAM_SUB_BITS)
+typedef struct {
+	uint64_t count;					// Values recorded
+	uint64_t min;					// Smallest value (ticks)
+	uint64_t max;					// Largest value (ticks)
+	uint64_t counts[QUICKSAND_HISTOGRAM_BUCKETS];	// Values per bucket
+} quicksand_histogram;
+
 // Quicksand Reader/Writer information struct
 typedef struct {
 	uint64_t read_stamp;	       // Last read timestamp
@@ -30,37 +128,373 @@ typedef struct {
 	uint64_t shared_memory_handle; // OS Shared memory handle
 	uint64_t shared_memory_size;   // Size of shared memory segment
 	quicksand_ringbuffer *buffer;  // Mapped ring buffer address
+	uint8_t *data;		       // First slot (geometry cached at connect)
+	uint64_t mask;		       // Ring length - 1
+	uint64_t stride;	       // Bytes per slot
+	int64_t max_payload;	       // Largest message a slot holds
+	int64_t sync;		       // Durability policy (QUICKSAND_SYNC_*)
+	int64_t peer_slot;	       // Registry entry or -1 if the table was full
+	uint64_t pid;		       // Owning process id (slot reservations)
+	int64_t grow;		       // Grow the topic on oversized writes
+	int64_t backpressure;	       // Writer policy (QUICKSAND_BLOCK...)
+	uint8_t *spill;		       // Writer side buffer (QUICKSAND_SPILL)
+	uint64_t spill_size;	       // Side buffer capacity (bytes)
+	uint64_t spill_head;	       // Side buffer first queued byte
+	uint64_t spill_tail;	       // Side buffer end of queued bytes
+	uint8_t *claim;		       // Slot held by quicksand_reserve or null
+	uint64_t claim_index;	       // Ring index of the held slot
+	int64_t claim_size;	       // Bytes reserved in the held slot
+	double wait_spin_ns;	       // Longest busy-spin phase of a wait
+	double wait_yield_ns;	       // Longest sched_yield phase of a wait
+	double wait_sleep_ns;	       // Longest single sleep of a wait
+	double arrival_ns;	       // Average gap between messages (learned)
+	uint64_t arrival_stamp;	       // Timestamp of the last message read
+	quicksand_histogram *latency;  // Write-to-read latency or null
 	uint8_t name[256];	       // Shared memory name
 } quicksand_connection;
 
+// Optional topic creation settings (zero for defaults)
+typedef struct {
+	int64_t ring_length; // Number of slots (rounded up to a power of two)
+	int64_t ring_ns;     // Ring depth in nanoseconds of message_rate traffic
+	int64_t grow;	     // Grow a smaller existing topic (and on large writes)
+	int64_t sync;	     // QUICKSAND_SYNC_* for a new file-backed topic
+	uint64_t type;	     // Payload type hash checked on connect (0 any)
+} quicksand_options;
+
+// Payload type hashes.  A topic created with a type hash refuses
+// connections that expect another one, so a struct that changed shape is
+// caught at connect time instead of being misread.  Hash a description of
+// the layout (a schema string, or at least the type name) with its size:
+//   options.type = QUICKSAND_TYPE_HASH(imu_sample);
+//   options.type = quicksand_type_hash("imu_sample{f64 acc[3];u64 t;}", sizeof(imu_sample));
+// In C++14 and later the hash is a constant expression.
+#if defined(__cplusplus) && __cplusplus >= 201402L
+#define QUICKSAND_CONSTEXPR constexpr
+#else
+#define QUICKSAND_CONSTEXPR
+#endif
+static inline QUICKSAND_CONSTEXPR uint64_t quicksand_type_hash(const char *schema, uint64_t size)
+{
+	uint64_t hash = 14695981039346656037ull; // FNV-1a over the schema and size
+	for(const char *p = schema; *p; p += 1) {
+		hash = (hash ^ (uint8_t) *p) * 1099511628211ull;
+	}
+	for(int i = 0; i < 64; i += 8) {
+		hash = (hash ^ ((size >> i) & 0xff)) * 1099511628211ull;
+	}
+	return hash ? hash : 1; // (0 means untyped)
+}
+#define QUICKSAND_TYPE_HASH(type) quicksand_type_hash(#type, sizeof(type))
+
+// Pacer overrun policies (quicksand_pacer_init)
+#define QUICKSAND_PACE_CATCHUP 0 // Release late deadlines back to back
+#define QUICKSAND_PACE_DROP 1	 // Skip deadlines that already passed
+
+// Timer sleeps overshoot by tens of microseconds: by default pacers wake up
+// this long before a deadline and busy-wait the rest
+#define QUICKSAND_PACE_SPIN_NS 50e3
+
+// Fixed-rate scheduler: deadline k is start + k * period (no drift)
+typedef struct {
+	uint64_t start;	     // Timestamp of deadline 0
+	double period;	     // Ticks between deadlines
+	uint64_t next;	     // Index of the next deadline
+	int64_t policy;	     // QUICKSAND_PACE_CATCHUP or QUICKSAND_PACE_DROP
+	double spin_ns;	     // Busy-wait before each deadline
+	uint64_t count;	     // Deadlines released
+	uint64_t missed;     // Deadlines skipped (QUICKSAND_PACE_DROP)
+	double error_ns;     // Last release time minus its deadline
+	double error_max_ns; // Largest release error
+	double error_sum_ns; // Sum of release errors
+	double error_sq_ns;  // Sum of squared release errors
+} quicksand_pacer;
+
+// Topic log files (quicksand_recorder): a QUICKSAND_LOG_HEADER byte
+// header, then records back to back until the end of the file
+#define QUICKSAND_LOG_MAGIC 0x474f4c444e415351ull // "QSANDLOG"
+#define QUICKSAND_LOG_VERSION 2
+#define QUICKSAND_LOG_HEADER 8192 // File header bytes (records follow)
+#define QUICKSAND_LOG_TOPICS 15	  // Topics per log
+
+// Log file topic table entry
+typedef struct {
+	char name[248];	       // Topic name
+	uint64_t message_size; // Largest payload of the topic
+	quicksand_clock clock; // Stamp calibration of the topic
+} quicksand_log_topic;
+
+// Log file header
+typedef struct {
+	uint64_t magic;					   // QUICKSAND_LOG_MAGIC
+	uint64_t version;				   // QUICKSAND_LOG_VERSION
+	uint64_t segment;				   // File number in the rotation
+	uint64_t topics;				   // Entries used in topic
+	quicksand_log_topic topic[QUICKSAND_LOG_TOPICS];   // Recorded topics
+	char pad[QUICKSAND_LOG_HEADER - 4 * sizeof(uint64_t)
+		 - QUICKSAND_LOG_TOPICS * sizeof(quicksand_log_topic)];
+} quicksand_log_header;
+
+// Log record header, followed by the payload padded to 8 bytes
+typedef struct {
+	uint64_t stamp;	 // Slot timestamp (the writer's quicksand_now)
+	uint32_t length; // Payload bytes
+	uint32_t topic;	 // Index into the header topic table
+} quicksand_log_record;
+
+// Recorder draining topics into size-rotated log files
+typedef struct {
+	quicksand_connection *topics[QUICKSAND_LOG_TOPICS]; // Drained topics
+	int64_t count;					     // Number of topics
+	int64_t fd;					     // Current file or -1
+	uint8_t *buffer;				     // Page-aligned write buffer
+	uint64_t buffer_size;				     // Write buffer capacity
+	uint64_t used;					     // Bytes buffered
+	uint64_t file_bytes;				     // Bytes in the current file
+	uint64_t max_file_bytes;			     // Rotation size (0 never)
+	uint64_t records;				     // Records written
+	uint64_t bytes;					     // Payload bytes written
+	uint64_t dropped;				     // Corrupted slots skipped
+	quicksand_log_header header;			     // Header of every file
+	char prefix[256];				     // Files are <prefix>.NNNNNN.qslog
+} quicksand_recorder;
+
+// Bridge stream: the sender opens with a hello carrying the topic geometry,
+// the receiver answers with an int64_t status (0 or -errno), then records
+// follow back to back, many per send.  Every integer on the wire is little
+// endian, so hosts of either byte order can be bridged.
+#define QUICKSAND_BRIDGE_MAGIC 0x4547444952425351ull // "QSBRIDGE"
+#define QUICKSAND_BRIDGE_VERSION 2
+
+// Bridge handshake
+typedef struct {
+	uint64_t magic;	       // QUICKSAND_BRIDGE_MAGIC
+	uint64_t version;      // QUICKSAND_BRIDGE_VERSION
+	uint64_t length;       // Ring slots of the source topic
+	uint64_t message_size; // Largest payload of the source topic
+	uint64_t type;	       // Payload type hash of the source topic
+	char name[256];	       // Source topic name
+} quicksand_bridge_hello;
+
+// Bridge record header, followed by the payload padded to 8 bytes
+typedef struct {
+	uint32_t length;  // Payload bytes
+	uint32_t skipped; // Messages the sender lost just before this one
+} quicksand_bridge_record;
+
+// One end of a bridged topic (one TCP stream per topic)
+typedef struct {
+	quicksand_connection *topic; // Source (sender) or mirror (receiver)
+	int64_t fd;		     // Socket
+	int64_t sender;		     // 1 on the sending end
+	uint8_t *buffer;	     // Coalescing (sender) or receive buffer
+	uint64_t buffer_size;	     // Buffer capacity
+	uint64_t used;		     // Bytes buffered
+	uint64_t messages;	     // Messages forwarded or republished
+	uint64_t bytes;		     // Payload bytes forwarded or republished
+	uint64_t sends;		     // send() calls, io_uring batches or recv() calls
+	uint64_t dropped;	     // Messages lost (ring overruns, failed writes)
+	void *uring;		     // io_uring transport (lossless senders) or null
+} quicksand_bridge;
+
+// Player republishing log files into their topics
+typedef struct {
+	quicksand_connection *topics[QUICKSAND_LOG_TOPICS]; // Output topics
+	int64_t count;					     // Number of topics
+	uint8_t *map;					     // Mapped log file or null
+	uint64_t map_size;				     // Bytes mapped
+	uint64_t offset;				     // Next record in the map
+	uint64_t segment;				     // Mapped file number
+	double speed;					     // Time multiplier (0 no pacing)
+	double ns_per_tick;				     // Recording clock calibration
+	uint64_t first_stamp;				     // Stamp of the first record
+	uint64_t start;					     // quicksand_now at the first record
+	uint64_t records;				     // Records published
+	uint64_t bytes;					     // Payload bytes published
+	uint64_t skipped;				     // Records the topics refused
+	char prefix[256];				     // Files are <prefix>.NNNNNN.qslog
+} quicksand_player;
+
+// Topic directory: a well-known segment listing every topic, so tools and
+// subscribers can discover topics without scanning /dev/shm.  Entries are
+// found by open addressing on the name hash; a deleted topic leaves its
+// entry as a tombstone that the next new name on that probe path reuses.
+#define QUICKSAND_DIRECTORY_NAME ".quicksand_directory"
+#define QUICKSAND_DIRECTORY_MAGIC 0x5952544345524944ull // "DIRECTRY"
+#define QUICKSAND_DIRECTORY_VERSION 1
+#define QUICKSAND_DIRECTORY_SLOTS 4096 // Names ever listed (power of two)
+
+// What the directory knows about a topic
+typedef struct {
+	uint64_t length;       // Number of slots
+	uint64_t message_size; // Largest payload (bytes)
+	uint64_t generation;   // Times the topic has grown
+	uint64_t type;	       // Type tag (0 if untyped)
+	uint64_t pid;	       // Creating (or first connecting) process
+	uint64_t created_ns;   // CLOCK_REALTIME when it was listed
+	char name[256];	       // Topic name
+} quicksand_topic_info;
+
+// Directory entry (state 0 free, 1 claimed, 2 listed, 3 deleted)
+typedef struct {
+	volatile _Atomic(uint64_t) state;		 // Entry state
+	volatile _Atomic(uint64_t) sequence;		 // Odd while info is updated
+	uint64_t hash;					 // Hash of the name
+	quicksand_topic_info info;			 // Name fixed while listed
+	volatile _Atomic(uint64_t) claimed;		 // CLOCK_MONOTONIC info update began
+	char pad[3 * QUICKSAND_LINE - 4 * sizeof(uint64_t) - sizeof(quicksand_topic_info)];
+} quicksand_directory_entry;
+
+typedef struct {
+	volatile _Atomic(uint64_t) magic;		       // QUICKSAND_DIRECTORY_MAGIC
+	uint64_t version;				       // QUICKSAND_DIRECTORY_VERSION
+	uint64_t slots;					       // Entries in the table
+	char pad[QUICKSAND_LINE - 3 * sizeof(uint64_t)];       //
+	quicksand_directory_entry entries[QUICKSAND_DIRECTORY_SLOTS]; // Hash table
+} quicksand_directory;
+
+// Blob pool: a companion segment (<topic>.blobs) holding large payloads, so
+// the ring only carries small handles.  Blobs come in power-of-two size
+// classes, each with a lock-free free list; a blob is returned to its list
+// when the last reference to it is released.
+#define QUICKSAND_POOL_MAGIC 0x4c4f4f5042534b51ull // "QKSBPOOL"
+#define QUICKSAND_POOL_VERSION 1
+#define QUICKSAND_POOL_CLASSES 24    // Size classes (4 KiB to 32 GiB)
+#define QUICKSAND_POOL_MIN_BLOB 4096 // Smallest class (blobs are page aligned)
+#define QUICKSAND_POOL_RETAIN 1024   // Most blobs a writer keeps readable
+
+// Handle of a published blob (what the ring carries)
+typedef struct {
+	uint64_t offset;     // Data offset in the pool segment
+	uint64_t length;     // Payload bytes
+	uint64_t generation; // Allocation the handle refers to
+} quicksand_blob;
+
+// Size class: free list head ([tag:32][entry + 1:32], 0 when empty) and
+// where its blobs live
+typedef struct {
+	volatile _Atomic(uint64_t) free;		   // Tagged Treiber stack head
+	uint64_t size;					   // Bytes per blob
+	uint64_t count;					   // Blobs in the class
+	uint64_t first;					   // Index of its first entry
+	uint64_t offset;				   // Data offset of its first blob
+	char pad[QUICKSAND_LINE - 5 * sizeof(uint64_t)];   //
+} quicksand_pool_class;
+
+// Per-blob bookkeeping (one cache line each)
+typedef struct {
+	volatile _Atomic(uint64_t) refs;		   // References (0 when free)
+	volatile _Atomic(uint64_t) generation;		   // Bumped on every allocation
+	volatile _Atomic(uint64_t) next;		   // Free list link (entry + 1)
+	char pad[CACHE_LINE_SIZE - 3 * sizeof(uint64_t)];  //
+} quicksand_pool_entry;
+
+// Pool segment header, followed by the entries and then the blob data
+typedef struct {
+	volatile _Atomic(uint64_t) magic;		   // QUICKSAND_POOL_MAGIC once ready
+	uint64_t version;				   // QUICKSAND_POOL_VERSION
+	uint64_t classes;				   // Size classes in use
+	uint64_t count;					   // Blobs per class
+	char pad[QUICKSAND_LINE - 4 * sizeof(uint64_t)];   //
+	quicksand_pool_class class[QUICKSAND_POOL_CLASSES]; // Smallest first
+} quicksand_pool_header;
+
+// Process-local view of a blob pool
+typedef struct {
+	quicksand_pool_header *header;			   // Mapped segment
+	uint64_t size;					   // Segment size
+	int64_t fd;					   // Segment descriptor
+	quicksand_pool_entry *entries;			   // Per-blob bookkeeping
+	uint64_t retain_head;				   // Oldest retained blob
+	uint64_t retain_tail;				   // Next retained position
+	quicksand_blob retained[QUICKSAND_POOL_RETAIN];	   // Published by this writer
+} quicksand_pool;
+
 /// Core reading/writing
 
-// Connect to a shared memory ring buffer
+// Connect to a shared memory ring buffer.  Topic names with a '/' after
+// the first character are file paths instead: the ring is kept in that
+// file (on tmpfs, DAX or an ordinary filesystem) and outlives reboots, so
+// the last messages are still there when the topic is reopened.
 // Parameters:
 // (OUT) connection: pointer to warren_tunnel object or null.
-// topic: shared memory segment name
+// topic: shared memory segment name or file path
 // topic_length: bytes of message size minus null termination (-1 to use strlen)
 // message_size: max size per message (-1 to connect)
 // message_rate: max number of messages per second (-1 to connect)
 // alloc: custom allocator following malloc(size_t) semantics, or null.
-// Returns: 0 if successful or -x for error
+// Returns: 0 if successful or -x for error: -EBADMSG for a segment that is
+// not a quicksand topic, -EPROTO for another format version,
+// -EPROTONOSUPPORT when the topic needs a feature this build lacks,
+// -EPROTOTYPE when it was created for another payload type and -ELOOP for
+// a chain of aliases that does not end in a topic.  Connections through an
+// alias report the topic's name.
 int64_t quicksand_connect(quicksand_connection **connection, char *topic,
 			  int64_t topic_length, int64_t message_size,
 			  int64_t message_rate, void *alloc);
 
+// Connect to a shared memory ring buffer with a ring depth that does not
+// depend on message_rate.  quicksand_connect keeps one second of messages
+// (ring_length = message_rate), which is mostly idle memory on fast topics.
+// Parameters: as quicksand_connect, plus
+// options: ring depth in slots (ring_length) or in time (ring_ns), or null;
+//          a type hash is stored by the creator and checked by everyone else
+//          (readers too), unless one side is untyped
+// Returns: 0 if successful or -x for error
+int64_t quicksand_connect_options(quicksand_connection **connection, char *topic,
+				  int64_t topic_length, int64_t message_size,
+				  int64_t message_rate, quicksand_options *options,
+				  void *alloc);
+
+// Connect a reader through a descriptor of the topic's segment instead of
+// its name, for processes that cannot open it themselves (sandboxed, in
+// another mount namespace).  The descriptor is duplicated, the caller
+// keeps its own.
+// Parameters:
+// (OUT) connection: pointer to warren_tunnel object or null.
+// fd: open (read/write) descriptor of the topic's shm object or file
+// topic: name the connection reports (file topics: the path)
+// alloc: custom allocator following malloc(size_t) semantics, or null.
+// Returns: 0 if successful or -x for error (as quicksand_connect)
+int64_t quicksand_connect_fd(quicksand_connection **connection, int64_t fd,
+			     char *topic, void *alloc);
+
+// Pass a connected topic to another process over a unix domain socket
+// (the descriptor as SCM_RIGHTS, the name as the message)
+// Returns: 0 if successful or -x for error
+int64_t quicksand_send_topic(int64_t socket, quicksand_connection *connection);
+
+// Receive a topic sent with quicksand_send_topic and connect a reader to it
+// Parameters:
+// socket: unix domain socket
+// (OUT) connection: pointer to warren_tunnel object or null.
+// alloc: custom allocator following malloc(size_t) semantics, or null.
+// Returns: 0 if successful or -x for error (-EPIPE when the socket was
+// closed, -EBADMSG for a message that carried no topic)
+int64_t quicksand_recv_topic(int64_t socket, quicksand_connection **connection,
+			     void *alloc);
+
 // Disconnect from a ring buffer and free connection memory
+// Connections to a topic from one process share a single mapping, which
+// is unmapped when the last of them disconnects.
 // Provide a custom deallocator following free(void*) semantics if required.
 void quicksand_disconnect(quicksand_connection **connection, void *dealloc);
 
 // Delete a topic, freeing it to be re-created (affects new connections)
 void quicksand_delete(char *topic, int64_t topic_length);
 
+// Write a file-backed topic out to its file (fdatasync), for topics that
+// use QUICKSAND_SYNC_NONE and want a checkpoint
+// Returns: 0 if successful or -x for error
+int64_t quicksand_sync(quicksand_connection *connection);
+
 // Write a message of a specified size to the ring buffer
 // Parameters:
 // connection: the initialized quicksand connection
 // message: pointer to message data to write
 // message_size: size of data to write.
-// Returns 0 if successful or -x for error
+// Returns 0 if successful or -x for error (-EAGAIN or -ENOBUFS when a
+// registered reader would be lapped, depending on the backpressure policy)
 int64_t quicksand_write(quicksand_connection *connection, uint8_t *message,
 			int64_t message_size);
 
@@ -73,6 +507,336 @@ int64_t quicksand_write(quicksand_connection *connection, uint8_t *message,
 int64_t quicksand_read(quicksand_connection *connection, uint8_t *message,
 		       int64_t *message_size);
 
+// Reserve the next slot and fill the message in place instead of copying
+// it in with quicksand_write.  The slot must be published with
+// quicksand_commit promptly: later writers wait for it in ring order.
+// Parameters:
+// connection: the initialized quicksand connection
+// (OUT) message: where to write the message (valid until the commit)
+// message_size: largest size the message will have
+// Returns: 0 if successful or -x for error (as quicksand_write; -EINVAL if
+// a slot is already reserved)
+int64_t quicksand_reserve(quicksand_connection *connection, uint8_t **message,
+			  int64_t message_size);
+
+// Publish the slot reserved by quicksand_reserve
+// Parameters:
+// connection: the initialized quicksand connection
+// message_size: bytes actually written, up to the reserved size (-1 cancels
+//               the message and readers skip its slot)
+// Returns: 0 if successful, -ECANCELED if cancelled, or -x for error
+int64_t quicksand_commit(quicksand_connection *connection, int64_t message_size);
+
+/// Topic aliases
+
+// Give a topic another name.  Connecting to the alias (as a reader or a
+// writer) connects to the topic itself, so one write reaches the readers of
+// every name; each reader keeps its own cursor as usual.  Aliases may name
+// other aliases (up to QUICKSAND_ALIAS_HOPS deep) or a topic that does not
+// exist yet, and are removed with quicksand_delete.
+// Parameters:
+// alias: new name (shared memory name or file path)
+// topic: name it stands for
+// Returns: 0 if successful (or the alias already names topic), -EEXIST if
+// the name is taken by another topic or alias, or -x for error
+int64_t quicksand_alias(char *alias, char *topic);
+
+/// Topic growth
+
+// Replace the topic with a larger ring without disconnecting anyone.
+// A new segment is built under a temporary name and renamed over the topic,
+// then the old one is marked with its successor generation: writers move
+// over on their next write and readers remap once they have drained the old
+// ring.  Registered readers stay registered on the new ring, so writers wait
+// for them there while they drain the old one.
+// Parameters:
+// connection: the initialized quicksand connection
+// message_size: new max size per message (-1 to keep)
+// ring_length: new number of slots (-1 to keep)
+// Returns: 0 if successful or -x for error
+int64_t quicksand_grow(quicksand_connection *connection, int64_t message_size,
+		       int64_t ring_length);
+
+/// Lossless backpressure
+
+// Register a reader so writers will not overwrite messages it has not read.
+// The reader publishes its cursor into the shared segment on every read and
+// no longer skips ahead; writers apply their backpressure policy instead.
+// Parameters:
+// connection: the initialized quicksand connection
+// Returns: 0 if successful, -ENOSPC if all peer entries are in use
+int64_t quicksand_register(quicksand_connection *connection);
+
+// Stop holding writers back (the peer entry is released on disconnect)
+void quicksand_unregister(quicksand_connection *connection);
+
+// Select what a writer does when the slowest registered reader would be lapped
+// Parameters:
+// connection: the initialized quicksand connection
+// policy: QUICKSAND_LOSSY, QUICKSAND_BLOCK (default), QUICKSAND_FAIL or
+//         QUICKSAND_SPILL
+// spill: side buffer used by QUICKSAND_SPILL (owned by the caller) or null
+// spill_size: size of the side buffer in bytes
+// Returns: 0 if successful or -x for error
+int64_t quicksand_backpressure(quicksand_connection *connection, int64_t policy,
+			       uint8_t *spill, int64_t spill_size);
+
+// Publish messages queued in the writer's side buffer (QUICKSAND_SPILL)
+// Returns: 0 if the side buffer is empty, -EAGAIN if messages remain queued
+int64_t quicksand_flush(quicksand_connection *connection);
+
+/// Latency monitoring
+
+// Record the write-to-read latency (slot timestamp to quicksand_read) of
+// every message this connection reads.  The histogram is allocated by the
+// caller and reset here; null stops recording (the default).
+// Parameters:
+// connection: the initialized quicksand connection
+// histogram: histogram to record into, or null
+// Returns: 0 if successful or -x for error
+int64_t quicksand_latency(quicksand_connection *connection,
+			  quicksand_histogram *histogram);
+
+// Add a value (in ticks) to a histogram
+void quicksand_histogram_record(quicksand_histogram *histogram, uint64_t ticks);
+
+// Clear all recorded values
+void quicksand_histogram_reset(quicksand_histogram *histogram);
+
+// Value at a percentile, e.g. 99.9 (the highest value of its bucket, so
+// the true percentile is at most this)
+// Parameters:
+// histogram: the histogram to query
+// percentile: 0 to 100
+// Returns: nanoseconds, or 0 when nothing was recorded
+double quicksand_histogram_percentile(quicksand_histogram *histogram,
+				      double percentile);
+
+/// Waiting
+
+// Set how this connection waits (writers on a busy ring, readers in
+// quicksand_wait).  A wait busy-spins, then calls sched_yield, then sleeps
+// until the next write wakes it.  The spin and yield phases follow the
+// recent gap between messages: a phase much shorter than the gap would not
+// catch the next message, so it is cut short instead of burning a core.
+// Parameters:
+// connection: the initialized quicksand connection
+// spin_ns: longest busy-spin phase (default 10 µs, 0 keeps the setting)
+// yield_ns: longest sched_yield phase (default 100 µs, 0 keeps the setting)
+// sleep_ns: longest single sleep (default 1 ms, 0 keeps the setting)
+// Returns: 0 if successful or -x for error
+int64_t quicksand_wait_policy(quicksand_connection *connection, double spin_ns,
+			      double yield_ns, double sleep_ns);
+
+// Wait for a new message to read
+// Parameters:
+// connection: the initialized quicksand connection
+// timeout_ns: give up after this long (negative waits forever)
+// Returns: 0 when quicksand_read has something to do, -ETIMEDOUT otherwise
+int64_t quicksand_wait(quicksand_connection *connection, double timeout_ns);
+
+/// Recording
+
+// Start recording topics to <prefix>.000000.qslog, <prefix>.000001.qslog...
+// Only messages written after this call are recorded.
+// Parameters:
+// (OUT) recorder: pointer to the recorder (allocated here)
+// prefix: path prefix of the log files
+// topics: names of existing topics to record
+// count: number of topics (at most QUICKSAND_LOG_TOPICS)
+// max_file_bytes: start a new file after this many bytes (0 never)
+// reliable: register as a lossless reader so writers wait for the recorder
+// Returns: 0 if successful or -x for error
+int64_t quicksand_record_open(quicksand_recorder **recorder, char *prefix,
+			      char **topics, int64_t count,
+			      int64_t max_file_bytes, int64_t reliable);
+
+// Drain every topic into the write buffer, writing it out in large
+// page-aligned blocks as it fills (a corrupted slot is skipped and counted
+// in dropped)
+// Returns: number of messages recorded or -x for error
+int64_t quicksand_record_poll(quicksand_recorder *recorder);
+
+// Write out everything buffered (the file then holds whole records)
+// Returns: 0 if successful or -x for error
+int64_t quicksand_record_flush(quicksand_recorder *recorder);
+
+// Flush, close the log and disconnect from the topics
+void quicksand_record_close(quicksand_recorder **recorder);
+
+/// Playback
+
+// Open recorded log files for playback into the recorded topics, which
+// are created (ring_length slots) if they do not exist yet.
+// Parameters:
+// (OUT) player: pointer to the player (allocated here)
+// prefix: path prefix of the log files, as given to quicksand_record_open
+// speed: playback time multiplier (2.0 twice as fast, 0 as fast as possible)
+// ring_length: ring depth of topics created for playback
+// Returns: 0 if successful or -x for error (-EBADMSG if not a log file)
+int64_t quicksand_play_open(quicksand_player **player, char *prefix, double speed,
+			    int64_t ring_length);
+
+// Publish up to count records, each once it is due
+// Returns: number of records published, 0 at the end of the log, or -x for
+// error (-EAGAIN or -ETIMEDOUT leave the record to be retried; records a
+// topic refuses, e.g. larger than its message size, are counted in skipped)
+int64_t quicksand_play(quicksand_player *player, int64_t count);
+
+// Unmap the log and disconnect from the topics
+void quicksand_play_close(quicksand_player **player);
+
+/// Network bridge
+
+// Listen for bridge senders
+// Parameters:
+// address: IPv4 or IPv6 address or host name to bind (null for any address
+//          of either family)
+// port: TCP port (0 picks a free one)
+// Returns: listening socket or -x for error
+int64_t quicksand_bridge_listen(char *address, int64_t port);
+
+// Forward a topic to a receiving host.  Messages written after this call
+// are read in batches and coalesced into as few sends as possible; one
+// stream serves every subscriber on the other host.
+// Parameters:
+// (OUT) bridge: pointer to the bridge (allocated here)
+// topic: existing local topic
+// host: receiving host name or address
+// port: receiver's TCP port
+// reliable: register as a lossless reader so local writers wait for the
+//           network instead of the bridge dropping messages.  Where the
+//           kernel allows it, a lossless bridge sends straight from the
+//           ring slots with io_uring (the mapping is a registered buffer)
+//           and only releases the slots once the sends complete.
+// Returns: 0 if successful or -x for error (the receiver's error if it
+// could not create the mirror topic)
+int64_t quicksand_bridge_send(quicksand_bridge **bridge, char *topic, char *host,
+			      int64_t port, int64_t reliable);
+
+// Accept one sender and create (or attach to) its mirror topic with the
+// same geometry
+// Parameters:
+// (OUT) bridge: pointer to the bridge (allocated here)
+// listener: socket from quicksand_bridge_listen
+// prefix: prepended to the source topic name for the mirror (or null)
+// Returns: 0 if successful or -x for error (-EINVAL if the mirror name
+// would be a file path: mirrors are only created in shared memory)
+int64_t quicksand_bridge_accept(quicksand_bridge **bridge, int64_t listener,
+				char *prefix);
+
+// Move pending messages across without blocking on an idle topic or
+// socket (a sender blocks while the network is congested)
+// Returns: number of messages moved, or -x for error (-EPIPE once the
+// other end closed)
+int64_t quicksand_bridge_poll(quicksand_bridge *bridge);
+
+// Close the stream and disconnect from the topic
+void quicksand_bridge_close(quicksand_bridge **bridge);
+
+/// Blob pool
+
+// Attach to (or create) the blob pool of a topic.  Writers allocate a blob,
+// fill it and publish its handle; readers read the handle from the ring and
+// acquire the blob for as long as they use it.  A published blob stays
+// readable until the writer has published as many newer handles as the
+// ring holds (or needs the memory for a new blob of its class); after that
+// acquiring it fails with -ESTALE.  Only touched blobs take memory, so generous counts
+// are cheap.  Blobs held by a process that dies are not reclaimed.
+// Parameters:
+// (OUT) pool: pointer to the pool (allocated here)
+// topic: topic the pool belongs to (the pool is <topic>.blobs)
+// max_blob: largest blob in bytes (-1 to attach to an existing pool)
+// count: blobs per size class (-1 to attach)
+// Returns: 0 if successful or -x for error (-EINVAL if an existing pool
+// has another geometry)
+int64_t quicksand_pool_connect(quicksand_pool **pool, char *topic, int64_t max_blob,
+			       int64_t count);
+
+// Allocate a blob of at least size bytes
+// Parameters:
+// pool: the connected pool
+// size: payload bytes
+// (OUT) blob: handle to publish
+// (OUT) data: where to write the payload
+// Returns: 0 if successful, -ENOBUFS if the size class is exhausted, or -x
+int64_t quicksand_pool_alloc(quicksand_pool *pool, int64_t size, quicksand_blob *blob,
+			     uint8_t **data);
+
+// Write a blob's handle to a topic.  The blob then belongs to the pool
+// (kept readable while the ring still holds its handle).
+// Parameters:
+// pool: the connected pool
+// connection: writer of the topic
+// blob: handle from quicksand_pool_alloc
+// Returns: 0 if successful or -x for error (as quicksand_write; the blob
+// is released if the handle could not be written)
+int64_t quicksand_pool_publish(quicksand_pool *pool, quicksand_connection *connection,
+			       quicksand_blob *blob);
+
+// Read the next blob handle from a topic and take a reference to the blob
+// before the slot is handed back, so a registered reader cannot lose it to
+// the writer moving on
+// Parameters:
+// pool: the connected pool
+// connection: reader of the topic
+// (OUT) blob: handle read from the ring
+// (OUT) data: the payload (blob->length bytes), valid until released
+// Returns: number of handles still pending, -1 if there was none, -ESTALE
+// if the blob was already reused (the handle is consumed), or -x
+int64_t quicksand_pool_read(quicksand_pool *pool, quicksand_connection *connection,
+			    quicksand_blob *blob, uint8_t **data);
+
+// Take a reference to a blob whose handle was read from the topic
+// Parameters:
+// pool: the connected pool
+// blob: handle read from the ring
+// (OUT) data: the payload (blob->length bytes), valid until released
+// Returns: 0 if successful, -ESTALE if the blob was already reused, or -x
+int64_t quicksand_pool_acquire(quicksand_pool *pool, quicksand_blob *blob,
+			       uint8_t **data);
+
+// Drop a reference taken by quicksand_pool_acquire (or an allocated blob
+// that will not be published)
+void quicksand_pool_release(quicksand_pool *pool, quicksand_blob *blob);
+
+// Release the retained blobs and unmap the pool
+void quicksand_pool_close(quicksand_pool **pool);
+
+/// Topic directory
+
+// Look a topic up in the directory (connect and delete keep it current)
+// Parameters:
+// topic: topic name
+// (OUT) info: snapshot of the entry
+// Returns: 0 if listed, -ENOENT if not, or -x if the directory is unusable
+int64_t quicksand_directory_find(char *topic, quicksand_topic_info *info);
+
+// List the topics in the directory
+// Parameters:
+// topics: output array for a snapshot of each listed topic, or null
+// max_topics: capacity of the topics array
+// Returns: number of listed topics, or -x if the directory is unusable
+int64_t quicksand_directory_list(quicksand_topic_info *topics, int64_t max_topics);
+
+/// Connection registry
+
+// Mark this connection as alive without reading or writing.
+// Reads and writes refresh the activity tick automatically; idle processes
+// should call this more often than QUICKSAND_TIMEOUT (250 ms).
+void quicksand_heartbeat(quicksand_connection *connection);
+
+// List the live peers of a topic, releasing entries of dead processes
+// (no heartbeat within the timeout and the owning pid no longer exists).
+// Parameters:
+// connection: the initialized quicksand connection
+// peers: output array for a snapshot of each live entry, or null
+// max_peers: capacity of the peers array
+// Returns: number of live peers including this connection (a topic is safe
+//          to quicksand_delete once this returns 1), or -x for error
+int64_t quicksand_peers(quicksand_connection *connection, quicksand_peer *peers,
+			int64_t max_peers);
+
 /// Timing functions
 
 // Monotonic time stamp counter (rdtsc on x86_64)
@@ -86,18 +850,109 @@ uint64_t quicksand_now(void);
 // Returns: number of nanoseconds elapsed between two timestamps
 double quicksand_ns(uint64_t final_timestamp, uint64_t initial_timestamp);
 
+// Convert elapsed ticks to integer nanoseconds using a fixed-point
+// multiply and shift (no floating point, no branches)
+// Parameters:
+// ticks: difference between two timestamps (final - initial)
+// Returns: number of nanoseconds
+uint64_t quicksand_ticks_ns(uint64_t ticks);
+
+// Convert an array of timestamps to nanoseconds since a base timestamp
+// Parameters:
+// stamps: timestamps to convert (each at or after base)
+// ns: output array of count nanosecond values (may alias stamps)
+// count: number of timestamps
+// base: timestamp that maps to 0 ns
+void quicksand_ticks_ns_array(const uint64_t *stamps, uint64_t *ns,
+			      int64_t count, uint64_t base);
+
 // Calibrate the nanosecond timer by sleeping for the specified nanoseconds time
 // Parameters:
 // nanoseconds: amount of time to sleep while calibrating
 // Returns: number of nanoseconds per tick
 double quicksand_ns_calibrate(double nanoseconds);
 
+// The timer is calibrated when the library loads, from the frequency the
+// hardware reports (CPUID / sysfs / CNTFRQ) or a 100 us measurement.
+// Setting QUICKSAND_DEFER_CLOCK in the environment skips the measurement:
+// the process then adopts the calibration of the first topic it connects
+// to, so it must connect (or call quicksand_ns_calibrate) before converting.
+// Without an invariant TSC, quicksand_now returns CLOCK_MONOTONIC nanoseconds.
+// Returns: 1 if quicksand_now reads an invariant hardware counter, else 0
+int64_t quicksand_clock_invariant(void);
+
+// Correct calibration drift by measuring the tick rate against
+// CLOCK_MONOTONIC over the whole time since the library was loaded.
+// Returns: number of nanoseconds per tick
+double quicksand_clock_sync(void);
+
+// Start a background thread that calls quicksand_clock_sync periodically
+// (calling again only changes the period).
+// Parameters:
+// period_ns: nanoseconds between corrections (at least 1 millisecond)
+// Returns: 0 if successful or -1 for error
+int64_t quicksand_clock_discipline(double period_ns);
+
 // Sleep for the specified number of nanoseconds.
 // Busy loops for times less than 100 microseconds.
 // Parameters:
 // nanoseconds: amount of time to sleep or busy-loop
 void quicksand_sleep(double nanoseconds);
 
+// Publish this process's calibration (and the CLOCK_MONOTONIC and
+// CLOCK_REALTIME offsets) into the topic.  Done once by the creator; call
+// again to correct drift on long-running topics.
+// Parameters:
+// connection: the initialized quicksand connection
+void quicksand_clock_update(quicksand_connection *connection);
+
+// Use the topic's calibration for quicksand_ns in this process, so
+// conversions agree across processes.  Attaching to a topic adopts it
+// automatically when this process only had a measured calibration.
+// Returns: 0 if successful, -1 if the topic has no calibration
+int64_t quicksand_clock_adopt(quicksand_connection *connection);
+
+// Convert a slot timestamp to CLOCK_MONOTONIC nanoseconds using the topic's
+// shared calibration (identical in every process)
+uint64_t quicksand_stamp_monotonic(quicksand_connection *connection,
+				   uint64_t stamp);
+
+// Convert a slot timestamp to CLOCK_REALTIME (wall clock) nanoseconds using
+// the topic's shared calibration (identical in every process)
+uint64_t quicksand_stamp_realtime(quicksand_connection *connection,
+				  uint64_t stamp);
+
+/// Pacing
+
+// Start a fixed-rate schedule, with the first deadline one period from now
+// Parameters:
+// pacer: the pacer to initialize
+// rate: deadlines per second
+// policy: QUICKSAND_PACE_CATCHUP or QUICKSAND_PACE_DROP for overruns
+// Returns: 0 if successful or -1 for error
+int64_t quicksand_pacer_init(quicksand_pacer *pacer, double rate, int64_t policy);
+
+// Set how long before each deadline the pacer stops sleeping and busy-waits
+// (QUICKSAND_PACE_SPIN_NS by default).  Longer windows absorb more timer
+// overshoot at the cost of a busy core; 0 sleeps all the way.
+// Parameters:
+// pacer: an initialized pacer
+// spin_ns: busy-wait window in nanoseconds
+// Returns: 0 if successful or -1 for error
+int64_t quicksand_pacer_spin(quicksand_pacer *pacer, double spin_ns);
+
+// Wait until the next deadline.  Deadlines are absolute timestamps, so time
+// spent between calls does not accumulate into drift.  Sleeps on the
+// system timer until shortly before the deadline, then busy-waits.
+// Parameters:
+// pacer: an initialized pacer
+// Returns: number of deadlines skipped (QUICKSAND_PACE_DROP), or that are
+//          still overdue (QUICKSAND_PACE_CATCHUP), 0 when on schedule
+int64_t quicksand_pace(quicksand_pacer *pacer);
+
+// Standard deviation of the release errors (jitter) in nanoseconds
+double quicksand_pacer_jitter(quicksand_pacer *pacer);
+
 /// Return elapsed time
 inline double quicksand_elapsed(uint64_t initial_timestamp)
 {
@@ -114,12 +969,12 @@ inline uint64_t quicksand_read_remaining(quicksand_connection *connection)
 inline int64_t quicksand_read_latest(quicksand_connection *connection,
 				     uint8_t *message, int64_t *message_size)
 {
-	// Return last message if new messages are available
+	// Jump to the last message if new messages are available
 	if(connection->read_index < connection->buffer->index) {
 		connection->read_index = connection->buffer->index - 1;
-		return quicksand_read(connection, message, message_size);
 	}
-	return -1;
+	// (also follows a grown topic when caught up)
+	return quicksand_read(connection, message, message_size);
 }
 
 
@@ -0,0 +1,60 @@
+#ifndef QUICKSAND_INTERNAL_H
+#define QUICKSAND_INTERNAL_H
+
+// Library-private layout and helpers shared between the translation units
+// (not installed with quicksand.h)
+
+#include "quicksand.h"
+#include "quicksand_style.h"
+
+#define QUICKSAND_TIMEOUT 250e6 // nanoseconds
+
+// Slot layout: [write_timestamp] + [message_len] + [owner] + [message]
+// owner = [reserve sequence (low 32 bits)][pid (32 bits)], pid 0 once a
+//         peer claimed the slot of a dead writer to skip it
+#define QUICKSAND_SLOT_HEADER 24
+#define QUICKSAND_SLOT_ABANDONED (-1) // message_len of a skipped slot
+
+// Spin-wait hint: lets the sibling hyperthread run and saves power
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ volatile("yield");
+#endif
+}
+
+// quicksand.c
+// Look at the published slot at index without consuming it.
+// Returns the payload length (payload points at it, stamp is its write
+// timestamp), QUICKSAND_SLOT_ABANDONED for a dead writer's slot or -EBADMSG
+i64 _quicksand_peek(quicksand_connection *c, u64 index, u8 **payload, u64 *stamp);
+// Batched reads: peek at the slots from c->read_index up to end, then hand
+// them back to the writers at once
+i64 _quicksand_pending(quicksand_connection *c, u64 *end);
+void _quicksand_consume(quicksand_connection *c, u64 index);
+
+// time.c
+// CLOCK_MONOTONIC in nanoseconds (also what quicksand_now falls back to)
+__attribute__((visibility("hidden"))) u64 quicksand_now_monotonic(void);
+i64 _quicksand_clock_attach(quicksand_connection *c);
+// Sequence lock in shared memory, taken over once its holder stalled past
+// QUICKSAND_TIMEOUT.  Returns 0 (sequence odd) or -EBUSY after wait_ns.
+i64 _quicksand_seq_lock(volatile _Atomic(u64) *sequence, volatile _Atomic(u64) *claimed,
+			f64 wait_ns);
+void _quicksand_seq_unlock(volatile _Atomic(u64) *sequence, volatile _Atomic(u64) *claimed);
+// Whether a sequence lock has been held past the timeout (its holder died)
+i64 _quicksand_seq_stale(volatile _Atomic(u64) *claimed);
+// Consistent snapshot of a topic calibration.
+// Returns its sequence, 0 if never published (or its updater died)
+u64 _quicksand_clock_read(quicksand_clock *clock, quicksand_clock *out);
+
+// directory.c
+i64 _quicksand_directory_add(const char *name, quicksand_topic_info *info, i64 replace);
+void _quicksand_directory_remove(const char *name);
+
+// pool.c
+void _quicksand_pool_unlink(const char *topic);
+
+#endif
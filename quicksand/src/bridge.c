@@ -0,0 +1,692 @@
+// -------------------------------------------------------------------------
+// bridge.c – forward topics between hosts over TCP
+// -------------------------------------------------------------------------
+//
+// Each bridged topic is one TCP stream.  The sender drains its ring into
+// a buffer of [quicksand_bridge_record][payload padded to 8] records and
+// sends it in one call, so a busy topic costs one send per poll rather
+// than one per message.  The receiver writes the records into a mirror
+// topic with the same geometry, where any number of local readers can
+// subscribe.  TCP (rather than UDP) carries the backpressure: a full
+// socket blocks the sender, and a lossless sender holds back the writers
+// of its topic.
+//
+// Lossless senders skip the coalescing copy when io_uring is available:
+// the topic mapping is registered as a fixed buffer and each message goes
+// out as a linked [record header][payload] pair of sends that read the
+// slot directly (zero-copy for large payloads).  The registered cursor is
+// what keeps writers off those slots, so it only moves once the kernel
+// reports the sends (and zero-copy notifications) complete.
+// -------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // for MSG_DONTWAIT
+
+#include "quicksand.h"
+#include "quicksand_internal.h"
+#include "quicksand_style.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define BRIDGE_BUFFER (64 * 1024) // coalescing bytes (grown for huge topics)
+#define URING_BATCH 128		  // messages per submission (two sends each)
+#define URING_ZC_MIN 4096	  // payloads below this are copied by the kernel
+
+// ---------------------------------------------------------------------
+// internal - blocking send/receive of exactly len bytes
+// ---------------------------------------------------------------------
+static i64 send_all(i64 fd, void *data, u64 len)
+{
+	u8 *p = data;
+	while(len) {
+		ssize_t n = send((int) fd, p, len, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return errno == ECONNRESET ? -EPIPE : -errno;
+		}
+		p += n;
+		len -= (u64) n;
+	}
+	return 0;
+}
+
+static i64 recv_all(i64 fd, void *data, u64 len)
+{
+	u8 *p = data;
+	while(len) {
+		ssize_t n = recv((int) fd, p, len, 0);
+		if(n == 0) {
+			return -EPIPE;
+		}
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		p += n;
+		len -= (u64) n;
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - allocate a bridge with room for a few of the largest records
+// ---------------------------------------------------------------------
+static quicksand_bridge *bridge_new(i64 fd, i64 sender, u64 message_size)
+{
+	quicksand_bridge *b = calloc(1, sizeof(quicksand_bridge));
+	if(!b) {
+		return NULL;
+	}
+	b->fd = fd;
+	b->sender = sender;
+	b->buffer_size = BRIDGE_BUFFER;
+	while(b->buffer_size < 4 * (message_size + sizeof(quicksand_bridge_record) + 8)) {
+		b->buffer_size *= 2;
+	}
+	b->buffer = malloc(b->buffer_size);
+	if(!b->buffer) {
+		free(b);
+		return NULL;
+	}
+	int one = 1;
+	setsockopt((int) fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return b;
+}
+
+// ---------------------------------------------------------------------
+// internal - io_uring transport state (raw syscalls, no liburing)
+// ---------------------------------------------------------------------
+typedef struct {
+	int fd;				      // io_uring instance
+	u8 *rings;			      // Submission and completion rings
+	u64 rings_size;			      // Bytes mapped for rings
+	struct io_uring_sqe *sqes;	      // Submission entries
+	u64 sqes_size;			      // Bytes mapped for sqes
+	_Atomic(u32) *sq_tail;		      // (kernel consumes from sq head)
+	u32 sq_mask;			      //
+	u32 *sq_array;			      // Indirection into sqes
+	_Atomic(u32) *cq_head;		      //
+	_Atomic(u32) *cq_tail;		      //
+	u32 cq_mask;			      //
+	struct io_uring_cqe *cqes;	      // Completions
+	quicksand_ringbuffer *registered;     // Mapping registered as buffer 0
+	quicksand_bridge_record header[URING_BATCH]; // Record headers in flight
+	u8 *payload[URING_BATCH];	      // Slot payloads in flight
+	u32 size[URING_BATCH];		      // Padded payload bytes
+	i32 result[2 * URING_BATCH];	      // Completion of each send
+} bridge_uring;
+
+static i64 uring_setup(u32 entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static i64 uring_enter(i64 fd, u32 submit, u32 complete, u32 flags)
+{
+	return syscall(__NR_io_uring_enter, (int) fd, submit, complete, flags, NULL, 0);
+}
+
+static i64 uring_register(i64 fd, u32 opcode, void *arg, u32 count)
+{
+	return syscall(__NR_io_uring_register, (int) fd, opcode, arg, count);
+}
+
+static void uring_close(bridge_uring *u)
+{
+	if(u->sqes) {
+		munmap(u->sqes, u->sqes_size);
+	}
+	if(u->rings) {
+		munmap(u->rings, u->rings_size);
+	}
+	if(u->fd >= 0) {
+		close(u->fd); // (releases the registered buffer)
+	}
+	free(u);
+}
+
+// ---------------------------------------------------------------------
+// internal - register the current topic mapping as fixed buffer 0
+// ---------------------------------------------------------------------
+static i64 uring_map(bridge_uring *u, quicksand_connection *c)
+{
+	if(u->registered) {
+		uring_register(u->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+		u->registered = NULL;
+	}
+	struct iovec iov = {.iov_base = c->buffer, .iov_len = c->shared_memory_size};
+	if(uring_register(u->fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0) {
+		return -errno; // (locked memory limit, file-backed topic...)
+	}
+	u->registered = c->buffer;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - open an io_uring for a lossless sender or return null when
+// the kernel does not offer what we need (the bridge then copies)
+// ---------------------------------------------------------------------
+static bridge_uring *uring_open(quicksand_connection *c)
+{
+	bridge_uring *u = calloc(1, sizeof(bridge_uring));
+	if(!u) {
+		return NULL;
+	}
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	u->fd = (int) uring_setup(2 * URING_BATCH, &p);
+	if(u->fd < 0 || !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+		uring_close(u); // (disabled, filtered or an old kernel)
+		return NULL;
+	}
+
+	// Sends must report their own opcodes as supported
+	u64 probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe *probe = calloc(1, probe_size);
+	i64 supported = probe && uring_register(u->fd, IORING_REGISTER_PROBE, probe, 256) == 0
+			&& probe->last_op >= IORING_OP_SEND_ZC
+			&& (probe->ops[IORING_OP_SEND].flags & IO_URING_OP_SUPPORTED)
+			&& (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+
+	u64 sq_size = p.sq_off.array + p.sq_entries * sizeof(u32);
+	u64 cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	u->rings_size = sq_size > cq_size ? sq_size : cq_size;
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	void *rings = supported ? mmap(NULL, u->rings_size, PROT_READ | PROT_WRITE,
+				       MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING)
+				: MAP_FAILED;
+	void *sqes = rings != MAP_FAILED ? mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES)
+					 : MAP_FAILED;
+	u->rings = rings != MAP_FAILED ? rings : NULL;
+	u->sqes = sqes != MAP_FAILED ? sqes : NULL;
+	if(!u->sqes || uring_map(u, c) != 0) {
+		uring_close(u);
+		return NULL;
+	}
+	u->sq_tail = (_Atomic(u32) *) (u->rings + p.sq_off.tail);
+	u->sq_mask = *(u32 *) (u->rings + p.sq_off.ring_mask);
+	u->sq_array = (u32 *) (u->rings + p.sq_off.array);
+	u->cq_head = (_Atomic(u32) *) (u->rings + p.cq_off.head);
+	u->cq_tail = (_Atomic(u32) *) (u->rings + p.cq_off.tail);
+	u->cq_mask = *(u32 *) (u->rings + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *) (u->rings + p.cq_off.cqes);
+	return u;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_bridge_listen – open a listening socket
+// ---------------------------------------------------------------------
+i64 quicksand_bridge_listen(char *address, i64 port)
+{
+	if(port < 0 || port > 65535) {
+		return -EINVAL;
+	}
+	char service[16];
+	snprintf(service, sizeof(service), "%ld", (long) port);
+	struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM,
+				 .ai_flags = AI_PASSIVE};
+	struct addrinfo *found = NULL;
+	if(getaddrinfo(address, service, &hints, &found) != 0) {
+		return -EINVAL;
+	}
+
+	// Without an address, prefer one dual-stack IPv6 socket for both
+	int fd = -1;
+	i64 ret = -EADDRNOTAVAIL;
+	for(int pass = 0; pass < 2 && fd < 0; pass += 1) {
+		for(struct addrinfo *a = found; a && fd < 0; a = a->ai_next) {
+			if(!address && (a->ai_family == AF_INET6) != (pass == 0)) {
+				continue;
+			}
+			fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+			if(fd < 0) {
+				ret = -errno;
+				continue;
+			}
+			int one = 1, zero = 0;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			if(a->ai_family == AF_INET6) {
+				setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+			}
+			if(bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, 16) != 0) {
+				ret = -errno;
+				close(fd);
+				fd = -1;
+			}
+		}
+	}
+	freeaddrinfo(found);
+	return fd >= 0 ? fd : ret;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_bridge_send – connect a local topic to a receiver
+// ---------------------------------------------------------------------
+i64 quicksand_bridge_send(quicksand_bridge **bridge, char *topic, char *host,
+			  i64 port, i64 reliable)
+{
+	if(!bridge || !topic || !host || port <= 0 || port > 65535) {
+		return -EINVAL;
+	}
+	quicksand_connection *c = NULL;
+	i64 ret = quicksand_connect(&c, topic, -1, -1, -1, NULL);
+	if(ret != 0) {
+		return ret;
+	}
+
+	char service[16];
+	snprintf(service, sizeof(service), "%ld", (long) port);
+	struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+	struct addrinfo *found = NULL;
+	if(getaddrinfo(host, service, &hints, &found) != 0) {
+		quicksand_disconnect(&c, NULL);
+		return -EHOSTUNREACH;
+	}
+	int fd = -1;
+	ret = -ECONNREFUSED;
+	for(struct addrinfo *a = found; a && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+			ret = -errno;
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(found);
+	if(fd < 0) {
+		quicksand_disconnect(&c, NULL);
+		return ret;
+	}
+
+	quicksand_bridge_hello hello = {
+			.magic = htole64(QUICKSAND_BRIDGE_MAGIC),
+			.version = htole64(QUICKSAND_BRIDGE_VERSION),
+			.length = htole64(c->mask + 1),
+			.message_size = htole64((u64) c->max_payload),
+			.type = htole64(c->buffer->type)};
+	snprintf(hello.name, sizeof(hello.name), "%s", (char *) c->name);
+	i64 status = 0;
+	ret = send_all(fd, &hello, sizeof(hello));
+	if(ret == 0) {
+		ret = recv_all(fd, &status, sizeof(status));
+		status = (i64) le64toh((u64) status);
+	}
+	quicksand_bridge *b = ret == 0 && status == 0
+				      ? bridge_new(fd, 1, (u64) c->max_payload)
+				      : NULL;
+	if(!b) {
+		close(fd);
+		quicksand_disconnect(&c, NULL);
+		return ret ? ret : status ? status : -ENOMEM;
+	}
+	b->topic = c;
+
+	// Forward what is written from now on
+	c->read_index = atomic_load_explicit(&c->buffer->index, memory_order_acquire);
+	if(reliable && quicksand_register(c) == 0) {
+		b->uring = uring_open(c);
+	}
+	*bridge = b;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_bridge_accept – take a sender and open its mirror topic
+// ---------------------------------------------------------------------
+i64 quicksand_bridge_accept(quicksand_bridge **bridge, i64 listener, char *prefix)
+{
+	if(!bridge || listener < 0) {
+		return -EINVAL;
+	}
+	int fd = accept((int) listener, NULL, NULL);
+	if(fd < 0) {
+		return -errno;
+	}
+	quicksand_bridge_hello hello;
+	i64 ret = recv_all(fd, &hello, sizeof(hello));
+	hello.magic = le64toh(hello.magic);
+	hello.version = le64toh(hello.version);
+	hello.length = le64toh(hello.length);
+	hello.message_size = le64toh(hello.message_size);
+	hello.type = le64toh(hello.type);
+	if(ret == 0 && (hello.magic != QUICKSAND_BRIDGE_MAGIC
+			|| hello.version != QUICKSAND_BRIDGE_VERSION
+			|| hello.message_size > (u64) 1e12 || hello.length > (u64) 1e12)) {
+		ret = -EPROTO;
+	}
+	char name[256];
+	hello.name[sizeof(hello.name) - 1] = 0;
+	if(ret == 0 && snprintf(name, sizeof(name), "%s%s", prefix ? prefix : "", hello.name)
+			       >= (int) sizeof(name)) {
+		ret = -ENAMETOOLONG;
+	}
+	// Mirrors are always shared memory: a '/' past the first character
+	// would let the sender pick a file path for us to create
+	if(ret == 0 && (!name[0] || strchr(name + 1, '/'))) {
+		ret = -EINVAL;
+	}
+
+	// The mirror gets the same geometry as the source
+	quicksand_connection *c = NULL;
+	if(ret == 0) {
+		quicksand_options options = {.ring_length = (i64) hello.length,
+					     .type = hello.type};
+		ret = quicksand_connect_options(&c, name, -1, (i64) hello.message_size, 1,
+						&options, NULL);
+	}
+	quicksand_bridge *b = ret == 0 ? bridge_new(fd, 0, hello.message_size) : NULL;
+	ret = ret == 0 && !b ? -ENOMEM : ret;
+	if(ret != -EPIPE) {
+		u64 status = htole64((u64) ret);
+		send_all(fd, &status, sizeof(status)); // (the sender reports our error)
+	}
+	if(ret != 0) {
+		free(b);
+		quicksand_disconnect(&c, NULL);
+		close(fd);
+		return ret;
+	}
+	b->topic = c;
+	*bridge = b;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - drain the source ring into one coalesced send
+// ---------------------------------------------------------------------
+static i64 bridge_forward(quicksand_bridge *b)
+{
+	quicksand_connection *c = b->topic;
+	i64 moved = 0;
+	for(u64 n = 0; n <= c->mask; n += 1) {
+		// quicksand_read consumes the slot before checking our space
+		if(b->used + sizeof(quicksand_bridge_record) + (u64) c->max_payload + 8
+		   > b->buffer_size) {
+			i64 ret = send_all(b->fd, b->buffer, b->used);
+			if(ret < 0) {
+				return ret;
+			}
+			b->sends += 1;
+			b->used = 0;
+		}
+		quicksand_bridge_record *record = (quicksand_bridge_record *) (b->buffer + b->used);
+		i64 length = (i64) (b->buffer_size - b->used - sizeof(*record));
+		quicksand_ringbuffer *rb = c->buffer;
+		u64 before = c->read_index;
+		i64 ret = quicksand_read(c, (u8 *) (record + 1), &length);
+		if(ret == -1) {
+			break; // caught up
+		}
+		if(ret < -1) {
+			return ret;
+		}
+		// A lossy reader that fell behind skips ahead (a grown topic
+		// restarts the count)
+		u64 skipped = c->buffer == rb ? c->read_index - 1 - before : 0;
+		skipped = skipped < UINT32_MAX ? skipped : UINT32_MAX;
+		record->length = htole32((u32) length);
+		record->skipped = htole32((u32) skipped);
+		u64 size = sizeof(*record) + (((u64) length + 7) & ~(u64) 7);
+		memset((u8 *) (record + 1) + length, 0, size - sizeof(*record) - (u64) length);
+		b->used += size;
+		b->messages += 1;
+		b->bytes += (u64) length;
+		b->dropped += skipped;
+		moved += 1;
+	}
+	if(b->used) {
+		i64 ret = send_all(b->fd, b->buffer, b->used);
+		if(ret < 0) {
+			return ret;
+		}
+		b->sends += 1;
+		b->used = 0;
+	}
+	return moved;
+}
+
+// ---------------------------------------------------------------------
+// internal - queue one send, linked to the next so the stream keeps order
+// ---------------------------------------------------------------------
+static void uring_send(bridge_uring *u, u32 *tail, i64 fd, void *data, u32 len,
+		       i64 zero_copy, u64 tag)
+{
+	u32 index = *tail & u->sq_mask;
+	struct io_uring_sqe *sqe = &u->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = zero_copy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+	sqe->ioprio = zero_copy ? IORING_RECVSEND_FIXED_BUF : 0; // (buf_index 0)
+	sqe->fd = (int) fd;
+	sqe->addr = (u64) (uintptr_t) data;
+	sqe->len = len;
+	sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->user_data = tag;
+	u->sq_array[index] = index;
+	*tail += 1;
+}
+
+// ---------------------------------------------------------------------
+// internal - submit the queued sends and wait for every completion and
+// zero-copy notification (after which the slots may be reused)
+// ---------------------------------------------------------------------
+static i64 uring_submit(bridge_uring *u, u32 tail, u32 queued)
+{
+	u->sqes[(tail - 1) & u->sq_mask].flags = 0; // (ends the link chain)
+	atomic_store_explicit(u->sq_tail, tail, memory_order_release);
+	u32 results = queued;
+	u32 notifications = 0;
+	while(results || notifications) {
+		i64 ret = uring_enter(u->fd, queued, 1, IORING_ENTER_GETEVENTS);
+		if(ret < 0 && errno != EINTR) {
+			return -errno;
+		}
+		queued -= ret > 0 ? (u32) ret < queued ? (u32) ret : queued : 0;
+		u32 head = atomic_load_explicit(u->cq_head, memory_order_relaxed);
+		u32 end = atomic_load_explicit(u->cq_tail, memory_order_acquire);
+		for(; head != end; head += 1) {
+			struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+			if(cqe->flags & IORING_CQE_F_NOTIF) {
+				notifications -= 1;
+				continue;
+			}
+			u->result[cqe->user_data] = cqe->res;
+			notifications += (cqe->flags & IORING_CQE_F_MORE) != 0;
+			results -= 1;
+		}
+		atomic_store_explicit(u->cq_head, head, memory_order_release);
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - forward straight from the ring slots with io_uring
+// ---------------------------------------------------------------------
+static i64 uring_forward(quicksand_bridge *b)
+{
+	bridge_uring *u = b->uring;
+	quicksand_connection *c = b->topic;
+	quicksand_ringbuffer *rb = c->buffer;
+	quicksand_peer *peer = &rb->peers[c->peer_slot];
+	i64 moved = 0;
+	while((u64) moved <= c->mask) {
+		u64 write_cursor = atomic_load_explicit(&rb->index, memory_order_acquire);
+		if(c->read_index == write_cursor) {
+			if(moved || !atomic_load_explicit(&rb->successor, memory_order_seq_cst)) {
+				break; // caught up
+			}
+			// Follow a grown topic with the copying path, which remaps
+			i64 ret = bridge_forward(b);
+			if(c->buffer != u->registered && uring_map(u, c) != 0) {
+				uring_close(u);
+				b->uring = NULL;
+			}
+			return ret;
+		}
+
+		// Queue a linked [header][payload] pair per published slot
+		u64 first = c->read_index;
+		u32 tail = atomic_load_explicit(u->sq_tail, memory_order_relaxed);
+		u32 count = 0;
+		u32 queued = 0;
+		u64 index = first;
+		for(; index != write_cursor && count < URING_BATCH; index += 1) {
+			u8 *payload = NULL;
+			u64 stamp = 0;
+			i64 length = _quicksand_peek(c, index, &payload, &stamp);
+			if(length == QUICKSAND_SLOT_ABANDONED) {
+				continue; // (a dead writer's slot, skipped by readers)
+			}
+			if(length < 0) {
+				if(index == first) {
+					return length;
+				}
+				break; // (send what came before)
+			}
+			u->header[count] = (quicksand_bridge_record){.length = htole32((u32) length)};
+			u->payload[count] = payload;
+			u->size[count] = (u32) (((u64) length + 7) & ~(u64) 7); // (padding zeroed by the writer)
+			u->result[2 * count + 1] = 0;
+			uring_send(u, &tail, b->fd, &u->header[count], sizeof(u->header[count]), 0,
+				   2 * count);
+			queued += 1;
+			if(u->size[count]) {
+				uring_send(u, &tail, b->fd, u->payload[count], u->size[count],
+					   u->size[count] >= URING_ZC_MIN, 2 * count + 1);
+				queued += 1;
+			}
+			b->bytes += (u64) length;
+			count += 1;
+		}
+		if(queued) {
+			i64 ret = uring_submit(u, tail, queued);
+			if(ret < 0) {
+				return ret;
+			}
+			b->sends += 1;
+		}
+
+		// A short send breaks the chain: finish it (and the sends that
+		// were cancelled after it) from the slots, which are still ours
+		i64 broken = 0;
+		for(u32 i = 0; i < 2 * count; i += 1) {
+			u8 *data = i & 1 ? u->payload[i / 2] : (u8 *) &u->header[i / 2];
+			i64 size = i & 1 ? u->size[i / 2] : (i64) sizeof(quicksand_bridge_record);
+			i64 done = broken ? 0 : u->result[i];
+			if(done == size || !size) {
+				continue;
+			}
+			if(done < 0 && done != -ECANCELED && done != -EINTR) {
+				return done == -ECONNRESET ? -EPIPE : done;
+			}
+			done = done > 0 ? done : 0;
+			i64 ret = send_all(b->fd, data + done, (u64) (size - done));
+			if(ret < 0) {
+				return ret;
+			}
+			broken = 1;
+		}
+
+		// The slots are free for the writers again
+		c->read_index = index;
+		atomic_store_explicit(&peer->tick, quicksand_now(), memory_order_relaxed);
+		atomic_store_explicit(&peer->cursor, index, memory_order_release);
+		b->messages += count;
+		moved += count;
+	}
+	return moved;
+}
+
+// ---------------------------------------------------------------------
+// internal - republish whatever complete records have arrived
+// ---------------------------------------------------------------------
+static i64 bridge_receive(quicksand_bridge *b)
+{
+	ssize_t n = recv((int) b->fd, b->buffer + b->used, b->buffer_size - b->used,
+			 MSG_DONTWAIT);
+	if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+		return -errno;
+	}
+	b->used += n > 0 ? (u64) n : 0;
+	b->sends += n > 0;
+
+	i64 moved = 0;
+	u64 offset = 0;
+	while(offset + sizeof(quicksand_bridge_record) <= b->used) {
+		quicksand_bridge_record *record = (quicksand_bridge_record *) (b->buffer + offset);
+		u32 length = le32toh(record->length);
+		u64 size = sizeof(*record) + (((u64) length + 7) & ~(u64) 7);
+		if(size > b->buffer_size) {
+			return -EPROTO;
+		}
+		if(offset + size > b->used) {
+			break; // rest still in flight
+		}
+		b->dropped += le32toh(record->skipped);
+		if(quicksand_write(b->topic, (u8 *) (record + 1), length) == 0) {
+			b->messages += 1;
+			b->bytes += length;
+			moved += 1;
+		} else {
+			b->dropped += 1; // mirror full (lossless reader behind) or locked
+		}
+		offset += size;
+	}
+	memmove(b->buffer, b->buffer + offset, b->used - offset);
+	b->used -= offset;
+	return n == 0 && !moved ? -EPIPE : moved;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_bridge_poll – forward or republish pending messages
+// ---------------------------------------------------------------------
+i64 quicksand_bridge_poll(quicksand_bridge *b)
+{
+	if(!b || b->fd < 0) {
+		return -EINVAL;
+	}
+	if(!b->sender) {
+		return bridge_receive(b);
+	}
+	return b->uring ? uring_forward(b) : bridge_forward(b);
+}
+
+// ---------------------------------------------------------------------
+// quicksand_bridge_close – close the stream and the topic
+// ---------------------------------------------------------------------
+void quicksand_bridge_close(quicksand_bridge **bridge)
+{
+	if(!bridge || !*bridge) {
+		return;
+	}
+	quicksand_bridge *b = *bridge;
+	if(b->uring) {
+		uring_close(b->uring);
+	}
+	if(b->fd >= 0) {
+		close((int) b->fd);
+	}
+	quicksand_disconnect(&b->topic, NULL);
+	free(b->buffer);
+	free(b);
+	*bridge = NULL;
+}
@@ -0,0 +1,315 @@
+// -------------------------------------------------------------------------
+// directory.c – well-known segment listing every topic
+// -------------------------------------------------------------------------
+//
+// The directory is a fixed open-addressed hash table in shared memory.
+// A name is only ever stored in the first free entry of its probe
+// sequence, and entries are never freed (a deleted topic is marked
+// deleted and keeps its name), so every process looking for a name walks
+// the same entries and two processes listing the same name meet in the
+// same entry.  Entries are claimed with a CAS; the rest of the info is
+// updated under a per-entry sequence lock.
+//
+// The table is mapped once per process.  If it cannot be opened (other
+// user, old layout) connecting still works, topics are just not listed.
+// -------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L // for shm_open, ftruncate, etc.
+
+#include "quicksand.h"
+#include "quicksand_internal.h"
+#include "quicksand_style.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DIRECTORY_FREE 0
+#define DIRECTORY_CLAIMED 1 // name being written
+#define DIRECTORY_LISTED 2
+#define DIRECTORY_DELETED 3
+#define DIRECTORY_UNAVAILABLE ((uintptr_t) 1)
+#define DIRECTORY_CLAIM_NS 10e6 // longest wait for a claimer to write the name
+
+_Static_assert(sizeof(quicksand_directory_entry) % QUICKSAND_LINE == 0,
+	       "directory entries must fill whole line pairs");
+
+static _Atomic(uintptr_t) directory = 0; // mapping, or DIRECTORY_UNAVAILABLE
+
+// ---------------------------------------------------------------------
+// internal - map (creating if needed) the directory, once per process
+// ---------------------------------------------------------------------
+static quicksand_directory *directory_map(void)
+{
+	uintptr_t mapped = atomic_load_explicit(&directory, memory_order_acquire);
+	if(mapped) {
+		return mapped == DIRECTORY_UNAVAILABLE ? NULL : (quicksand_directory *) mapped;
+	}
+
+	// Zero-filled entries are free, so whoever comes first just sizes it
+	uintptr_t result = DIRECTORY_UNAVAILABLE;
+	int fd = shm_open(QUICKSAND_DIRECTORY_NAME, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	struct stat sb;
+	if(fd >= 0 && fstat(fd, &sb) == 0
+	   && (sb.st_size == sizeof(quicksand_directory)
+	       || (sb.st_size == 0 && ftruncate(fd, sizeof(quicksand_directory)) == 0))) {
+		void *addr = mmap(NULL, sizeof(quicksand_directory), PROT_READ | PROT_WRITE,
+				  MAP_SHARED, fd, 0);
+		quicksand_directory *d = addr != MAP_FAILED ? addr : NULL;
+		if(d && atomic_load_explicit(&d->magic, memory_order_acquire) == 0) {
+			d->version = QUICKSAND_DIRECTORY_VERSION; // (every creator writes the same)
+			d->slots = QUICKSAND_DIRECTORY_SLOTS;
+			atomic_store_explicit(&d->magic, QUICKSAND_DIRECTORY_MAGIC, memory_order_release);
+		}
+		if(d && d->version == QUICKSAND_DIRECTORY_VERSION
+		   && d->slots == QUICKSAND_DIRECTORY_SLOTS) {
+			result = (uintptr_t) d;
+		} else if(d) {
+			munmap(d, sizeof(quicksand_directory));
+		}
+	}
+	if(fd >= 0) {
+		close(fd); // (the mapping stays)
+	}
+
+	// Another thread may have mapped it meanwhile
+	uintptr_t expected = 0;
+	if(!atomic_compare_exchange_strong_explicit(&directory, &expected, result,
+						    memory_order_acq_rel, memory_order_acquire)) {
+		if(result != DIRECTORY_UNAVAILABLE) {
+			munmap((void *) result, sizeof(quicksand_directory));
+		}
+		result = expected;
+	}
+	return result == DIRECTORY_UNAVAILABLE ? NULL : (quicksand_directory *) result;
+}
+
+static u64 directory_hash(const char *name)
+{
+	u64 hash = 14695981039346656037ull; // FNV-1a
+	for(const char *p = name; *p; p += 1) {
+		hash = (hash ^ (u8) *p) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Sequence lock around an entry's name and info (writers may race on one
+// name).  A lock left by a dead process is taken over after the timeout.
+static i64 directory_lock(quicksand_directory_entry *e)
+{
+	return _quicksand_seq_lock(&e->sequence, &e->claimed, QUICKSAND_TIMEOUT);
+}
+
+static void directory_unlock(quicksand_directory_entry *e)
+{
+	_quicksand_seq_unlock(&e->sequence, &e->claimed);
+}
+
+// Wait (briefly) for a claimer to write the name of entry e
+static u64 directory_settle(quicksand_directory_entry *e)
+{
+	u64 state = atomic_load_explicit(&e->state, memory_order_acquire);
+	u64 start = quicksand_now();
+	while(state == DIRECTORY_CLAIMED
+	      && quicksand_ns(quicksand_now(), start) < DIRECTORY_CLAIM_NS) {
+		state = atomic_load_explicit(&e->state, memory_order_acquire);
+	}
+	return state;
+}
+
+static i64 directory_named(quicksand_directory_entry *e, u64 hash, const char *name)
+{
+	return e->hash == hash && strncmp(e->info.name, name, sizeof(e->info.name)) == 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - entry holding name, or null.  With create, a name that is
+// not listed claims the first tombstone (or else free entry) of its probe
+// sequence.  state receives the entry state once its name is readable
+// (the previous state of a claimed entry, which stays DIRECTORY_CLAIMED).
+// ---------------------------------------------------------------------
+static quicksand_directory_entry *directory_probe(quicksand_directory *d, const char *name,
+						  i64 create, u64 *state)
+{
+	u64 hash = directory_hash(name);
+	u64 mask = QUICKSAND_DIRECTORY_SLOTS - 1;
+retry:;
+	quicksand_directory_entry *tombstone = NULL;
+	quicksand_directory_entry *e = NULL;
+	for(u64 i = 0; i < QUICKSAND_DIRECTORY_SLOTS; i += 1) {
+		e = &d->entries[(hash + i) & mask];
+		*state = directory_settle(e);
+		if(*state == DIRECTORY_FREE) {
+			break; // end of the probe sequence
+		}
+		if(*state == DIRECTORY_DELETED && create) {
+			tombstone = tombstone ? tombstone : e; // (even one with our name)
+		} else if(*state != DIRECTORY_CLAIMED && directory_named(e, hash, name)) {
+			return e;
+		}
+		e = NULL;
+	}
+	if(!create) {
+		return NULL;
+	}
+	e = tombstone ? tombstone : e;
+	*state = tombstone ? DIRECTORY_DELETED : DIRECTORY_FREE;
+	if(!e) {
+		return NULL; // table full
+	}
+	u64 expected = *state;
+	if(!atomic_compare_exchange_strong_explicit(&e->state, &expected, DIRECTORY_CLAIMED,
+						    memory_order_acquire, memory_order_relaxed)) {
+		goto retry; // someone claimed it first: maybe for our name
+	}
+	if(directory_lock(e)) {
+		atomic_store_explicit(&e->state, *state, memory_order_release);
+		return NULL;
+	}
+	e->hash = hash;
+	snprintf(e->info.name, sizeof(e->info.name), "%s", name);
+	directory_unlock(e);
+
+	// A racing lister may have claimed an earlier entry for the same name
+	for(u64 i = 0; &d->entries[(hash + i) & mask] != e; i += 1) {
+		quicksand_directory_entry *earlier = &d->entries[(hash + i) & mask];
+		u64 seen = directory_settle(earlier);
+		if((seen == DIRECTORY_LISTED || seen == DIRECTORY_CLAIMED)
+		   && directory_named(earlier, hash, name)) {
+			atomic_store_explicit(&e->state, DIRECTORY_DELETED, memory_order_release);
+			*state = seen;
+			return earlier;
+		}
+	}
+	return e; // (still DIRECTORY_CLAIMED)
+}
+
+// ---------------------------------------------------------------------
+// internal - list a topic (replace: also update the geometry of a listed
+// one).  Called by quicksand.c on connect and growth.
+// ---------------------------------------------------------------------
+i64 _quicksand_directory_add(const char *name, quicksand_topic_info *info, i64 replace)
+{
+	quicksand_directory *d = directory_map();
+	if(!d) {
+		return -ENOENT;
+	}
+	u64 state = DIRECTORY_FREE;
+	quicksand_directory_entry *e = directory_probe(d, name, 1, &state);
+	if(!e) {
+		return -ENOSPC;
+	}
+	if(state == DIRECTORY_LISTED && !replace) {
+		return 0; // already known
+	}
+	if(directory_lock(e)) {
+		if(state == DIRECTORY_FREE || state == DIRECTORY_DELETED) { // (ours)
+			atomic_store_explicit(&e->state, DIRECTORY_DELETED, memory_order_release);
+		}
+		return -ETIMEDOUT;
+	}
+	e->info.length = info->length;
+	e->info.message_size = info->message_size;
+	e->info.generation = info->generation;
+	e->info.type = info->type;
+	if(state != DIRECTORY_LISTED) { // a new (or re-created) topic
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		e->info.pid = (u64) getpid();
+		e->info.created_ns = (u64) ts.tv_sec * (u64) 1e9 + (u64) ts.tv_nsec;
+	}
+	directory_unlock(e);
+	atomic_store_explicit(&e->state, DIRECTORY_LISTED, memory_order_release);
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - mark a deleted topic (quicksand_delete)
+// ---------------------------------------------------------------------
+void _quicksand_directory_remove(const char *name)
+{
+	quicksand_directory *d = directory_map();
+	u64 state = DIRECTORY_FREE;
+	quicksand_directory_entry *e = d ? directory_probe(d, name, 0, &state) : NULL;
+	if(e && state == DIRECTORY_LISTED) {
+		atomic_compare_exchange_strong_explicit(&e->state, &state, DIRECTORY_DELETED,
+							memory_order_release, memory_order_relaxed);
+	}
+}
+
+// Consistent snapshot of a listed entry, 0 if it is not listed (or an
+// update never finishes: its writer died)
+static i64 directory_read(quicksand_directory_entry *e, quicksand_topic_info *out)
+{
+	u64 start = quicksand_now();
+	for(;;) {
+		u64 sequence = atomic_load_explicit(&e->sequence, memory_order_acquire);
+		u64 state = atomic_load_explicit(&e->state, memory_order_acquire);
+		memcpy(out, (const void *) &e->info, sizeof(*out));
+		atomic_thread_fence(memory_order_acquire);
+		if(!(sequence & 1)
+		   && sequence == atomic_load_explicit(&e->sequence, memory_order_relaxed)) {
+			return state == DIRECTORY_LISTED;
+		}
+		if(((sequence & 1) && _quicksand_seq_stale(&e->claimed))
+		   || quicksand_ns(quicksand_now(), start) > QUICKSAND_TIMEOUT) {
+			return 0;
+		}
+		cpu_relax();
+	}
+}
+
+// ---------------------------------------------------------------------
+// quicksand_directory_find – look a topic up
+// ---------------------------------------------------------------------
+i64 quicksand_directory_find(char *topic, quicksand_topic_info *info)
+{
+	if(!topic || !info) {
+		return -EINVAL;
+	}
+	quicksand_directory *d = directory_map();
+	if(!d) {
+		return -EACCES;
+	}
+	u64 state = DIRECTORY_FREE;
+	quicksand_directory_entry *e = directory_probe(d, topic, 0, &state);
+	if(!e || !directory_read(e, info)
+	   || strncmp(info->name, topic, sizeof(info->name)) != 0) {
+		return -ENOENT; // (or the entry was reused meanwhile)
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_directory_list – snapshot every listed topic
+// ---------------------------------------------------------------------
+i64 quicksand_directory_list(quicksand_topic_info *topics, i64 max_topics)
+{
+	if(max_topics > 0 && !topics) {
+		return -EINVAL;
+	}
+	quicksand_directory *d = directory_map();
+	if(!d) {
+		return -EACCES;
+	}
+	i64 count = 0;
+	quicksand_topic_info info;
+	for(u64 i = 0; i < QUICKSAND_DIRECTORY_SLOTS; i += 1) {
+		quicksand_directory_entry *e = &d->entries[i];
+		if(atomic_load_explicit(&e->state, memory_order_acquire) != DIRECTORY_LISTED
+		   || !directory_read(e, &info)) {
+			continue;
+		}
+		if(count < max_topics) {
+			topics[count] = info;
+		}
+		count += 1;
+	}
+	return count;
+}
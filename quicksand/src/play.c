@@ -0,0 +1,197 @@
+// -------------------------------------------------------------------------
+// play.c – republish recorded log files into their topics
+// -------------------------------------------------------------------------
+//
+// Log files (see record.c) are mapped read-only, one at a time, and each
+// payload is copied straight from the mapping into a slot reserved with
+// quicksand_reserve: there is no staging buffer between the page cache
+// and the ring.  Records are released at their recorded spacing divided
+// by the speed multiplier, or back to back when speed is 0.
+// -------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // for madvise
+
+#include "quicksand.h"
+#include "quicksand_style.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------
+// internal - map log file number segment
+// ---------------------------------------------------------------------
+static i64 map_segment(quicksand_player *p, u64 segment)
+{
+	if(p->map) {
+		munmap(p->map, p->map_size);
+		p->map = NULL;
+	}
+	char path[sizeof(p->prefix) + 32];
+	snprintf(path, sizeof(path), "%s.%06lu.qslog", p->prefix, (unsigned long) segment);
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return -errno;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (u64) st.st_size < QUICKSAND_LOG_HEADER) {
+		close(fd);
+		return -EBADMSG;
+	}
+	u8 *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		return -errno;
+	}
+	quicksand_log_header *header = (quicksand_log_header *) map;
+	if(header->magic != QUICKSAND_LOG_MAGIC || header->version != QUICKSAND_LOG_VERSION
+	   || header->segment != segment || header->topics < 1
+	   || header->topics > QUICKSAND_LOG_TOPICS) {
+		munmap(map, (size_t) st.st_size);
+		return -EBADMSG;
+	}
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+	p->map = map;
+	p->map_size = (u64) st.st_size;
+	p->offset = QUICKSAND_LOG_HEADER;
+	p->segment = segment;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_play_open – map the first file and connect to its topics
+// ---------------------------------------------------------------------
+i64 quicksand_play_open(quicksand_player **player, char *prefix, f64 speed,
+			i64 ring_length)
+{
+	if(!player || !prefix || speed < 0.0 || ring_length < 1
+	   || strlen(prefix) >= sizeof((*player)->prefix)) {
+		return -EINVAL;
+	}
+	quicksand_player *p = calloc(1, sizeof(quicksand_player));
+	if(!p) {
+		return -ENOMEM;
+	}
+	strcpy(p->prefix, prefix);
+	p->speed = speed;
+	i64 ret = map_segment(p, 0);
+	if(ret != 0) {
+		free(p);
+		return ret;
+	}
+	quicksand_log_header *header = (quicksand_log_header *) p->map;
+	p->ns_per_tick = header->topic[0].clock.ns_per_tick; // (stamps share one counter)
+	if(p->ns_per_tick <= 0.0) {
+		p->ns_per_tick = quicksand_ns(1000000, 0) / 1e6; // recorded without a calibration
+	}
+	for(u64 i = 0; i < header->topics && ret == 0; i += 1) {
+		quicksand_log_topic *topic = &header->topic[i];
+		char name[sizeof(topic->name)];
+		snprintf(name, sizeof(name), "%.*s", (int) sizeof(name) - 1, topic->name);
+		ret = quicksand_connect(&p->topics[i], name, -1, -1, -1, NULL);
+		if(ret != 0) {
+			quicksand_options options = {.ring_length = ring_length};
+			ret = quicksand_connect_options(&p->topics[i], name, -1,
+							(i64) topic->message_size, 1,
+							&options, NULL);
+		}
+		p->count = ret == 0 ? (i64) i + 1 : p->count;
+	}
+	if(ret != 0) {
+		quicksand_play_close(&p);
+		return ret;
+	}
+	*player = p;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_play – publish the next records as they fall due
+// ---------------------------------------------------------------------
+i64 quicksand_play(quicksand_player *p, i64 count)
+{
+	if(!p || !p->map) {
+		return p && p->count ? 0 : -EINVAL;
+	}
+	i64 played = 0;
+	while(played < count) {
+		// Move on to the next file at the end of this one (a torn final
+		// record from an interrupted recording also ends the file)
+		quicksand_log_record *record = (quicksand_log_record *) (p->map + p->offset);
+		if(p->offset + sizeof(*record) > p->map_size
+		   || p->offset + sizeof(*record) + record->length > p->map_size) {
+			i64 ret = map_segment(p, p->segment + 1);
+			if(ret == -ENOENT) {
+				munmap(p->map, p->map_size);
+				p->map = NULL;
+				break; // end of the log
+			}
+			if(ret != 0) {
+				return ret;
+			}
+			continue;
+		}
+		u64 size = sizeof(*record) + (((u64) record->length + 7) & ~(u64) 7);
+		if(record->topic >= p->count) {
+			p->offset += size;
+			continue;
+		}
+
+		if(!p->start) {
+			p->first_stamp = record->stamp;
+			p->start = quicksand_now();
+		}
+		i64 ticks = (i64) (record->stamp - p->first_stamp);
+		if(p->speed > 0.0 && ticks > 0) {
+			// quicksand_sleep sleeps, then busy-loops the last stretch
+			f64 due_ns = (f64) ticks * p->ns_per_tick / p->speed;
+			quicksand_sleep(due_ns - quicksand_ns(quicksand_now(), p->start));
+		}
+
+		quicksand_connection *c = p->topics[record->topic];
+		u8 *message = NULL;
+		i64 ret = quicksand_reserve(c, &message, record->length);
+		if(ret == -EAGAIN || ret == -ETIMEDOUT) {
+			return played ? played : ret;
+		}
+		p->offset += size;
+		if(ret != 0) {
+			p->skipped += 1; // (does not fit the topic, say)
+			continue;
+		}
+		memcpy(message, record + 1, record->length);
+		ret = quicksand_commit(c, record->length);
+		if(ret != 0) {
+			return played ? played : ret;
+		}
+		p->records += 1;
+		p->bytes += record->length;
+		played += 1;
+	}
+	return played;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_play_close – unmap and disconnect
+// ---------------------------------------------------------------------
+void quicksand_play_close(quicksand_player **player)
+{
+	if(!player || !*player) {
+		return;
+	}
+	quicksand_player *p = *player;
+	if(p->map) {
+		munmap(p->map, p->map_size);
+	}
+	for(i64 i = 0; i < p->count; i += 1) {
+		quicksand_disconnect(&p->topics[i], NULL);
+	}
+	free(p);
+	*player = NULL;
+}
@@ -0,0 +1,477 @@
+// -------------------------------------------------------------------------
+// pool.c – blob pool for payloads too large to copy through a ring
+// -------------------------------------------------------------------------
+//
+// The pool is a companion segment of a topic (<topic>.blobs).  Its blobs
+// come in power-of-two size classes with the same number of blobs each,
+// laid out class by class after a table of per-blob entries.  Free blobs
+// of a class sit on a Treiber stack whose head carries a tag bumped on
+// every change, so a head that was popped and pushed back in between
+// (ABA) fails the CAS.
+//
+// A blob is alive while its reference count is non-zero.  The writer's
+// reference is kept by the pool after publishing (until the ring has
+// overwritten the handle); readers add theirs with a CAS that never
+// revives a free blob, then check the generation so a handle to a blob
+// that was freed and allocated again is refused.  quicksand_pool_read
+// takes the reference before handing the slot back, so a registered
+// reader always gets its blob.
+// -------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L // for shm_open, ftruncate, etc.
+
+#include "quicksand.h"
+#include "quicksand_internal.h"
+#include "quicksand_style.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define POOL_TIMEOUT 250e6 // longest wait for a creator to initialize it
+#define POOL_INDEX 0xffffffffull
+#define POOL_MAX_COUNT (1 << 20) // blobs per class (keeps sizes far from overflow)
+
+_Static_assert(sizeof(quicksand_pool_entry) == CACHE_LINE_SIZE,
+	       "pool entries must not share lines");
+
+// Pool segments follow their topic: files next to a file topic, shared
+// memory otherwise (as quicksand.c decides)
+static void pool_name(char *name, u64 size, const char *topic)
+{
+	snprintf(name, size, "%s.blobs", topic);
+}
+
+static int pool_open(const char *name, int flags, mode_t mode)
+{
+	return name[0] && strchr(name + 1, '/') ? open(name, flags | O_CLOEXEC, mode)
+						: shm_open(name, flags, mode);
+}
+
+static void pool_unlink(const char *name)
+{
+	if(name[0] && strchr(name + 1, '/')) {
+		unlink(name);
+	} else {
+		shm_unlink(name);
+	}
+}
+
+static i64 pool_classes(i64 max_blob)
+{
+	i64 classes = 1;
+	while(classes < QUICKSAND_POOL_CLASSES
+	      && ((i64) QUICKSAND_POOL_MIN_BLOB << (classes - 1)) < max_blob) {
+		classes += 1;
+	}
+	return ((i64) QUICKSAND_POOL_MIN_BLOB << (classes - 1)) < max_blob ? -1 : classes;
+}
+
+static u64 pool_entries_offset(void)
+{
+	return sizeof(quicksand_pool_header);
+}
+
+static u64 pool_data_offset(u64 blobs)
+{
+	u64 end = pool_entries_offset() + blobs * sizeof(quicksand_pool_entry);
+	return (end + QUICKSAND_POOL_MIN_BLOB - 1) & ~(u64) (QUICKSAND_POOL_MIN_BLOB - 1);
+}
+
+// ---------------------------------------------------------------------
+// internal - lay out a new pool and put every blob on its free list
+// ---------------------------------------------------------------------
+static void pool_format(quicksand_pool_header *h, i64 classes, i64 count)
+{
+	quicksand_pool_entry *entries = (quicksand_pool_entry *) ((u8 *) h + pool_entries_offset());
+	u64 offset = pool_data_offset((u64) (classes * count));
+	for(i64 k = 0; k < classes; k += 1) {
+		quicksand_pool_class *c = &h->class[k];
+		c->size = (u64) QUICKSAND_POOL_MIN_BLOB << k;
+		c->count = (u64) count;
+		c->first = (u64) (k * count);
+		c->offset = offset;
+		for(i64 j = 0; j < count; j += 1) {
+			quicksand_pool_entry *e = &entries[c->first + (u64) j];
+			atomic_store_explicit(&e->refs, 0, memory_order_relaxed);
+			atomic_store_explicit(&e->generation, 0, memory_order_relaxed);
+			atomic_store_explicit(&e->next, j + 1 < count ? c->first + (u64) j + 2 : 0,
+					      memory_order_relaxed);
+		}
+		atomic_store_explicit(&c->free, c->first + 1, memory_order_relaxed);
+		offset += c->size * (u64) count;
+	}
+	h->version = QUICKSAND_POOL_VERSION;
+	h->classes = (u64) classes;
+	h->count = (u64) count;
+	atomic_store_explicit(&h->magic, QUICKSAND_POOL_MAGIC, memory_order_release);
+}
+
+static u64 pool_size(i64 classes, i64 count)
+{
+	u64 data = 0;
+	for(i64 k = 0; k < classes; k += 1) {
+		data += ((u64) QUICKSAND_POOL_MIN_BLOB << k) * (u64) count;
+	}
+	return pool_data_offset((u64) (classes * count)) + data;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_connect – attach to (or create) a topic's blob pool
+// ---------------------------------------------------------------------
+i64 quicksand_pool_connect(quicksand_pool **out, char *topic, i64 max_blob, i64 count)
+{
+	if(!out || !topic || !topic[0] || strlen(topic) > 255) {
+		return -EINVAL;
+	}
+	i64 create = max_blob > 0 && count > 0;
+	i64 classes = create ? pool_classes(max_blob) : 0;
+	if(classes < 0 || count > POOL_MAX_COUNT) {
+		return -EINVAL;
+	}
+	char name[256 + 8];
+	pool_name(name, sizeof(name), topic);
+
+	i64 created = 0;
+	int fd = pool_open(name, O_RDWR, 0);
+	if(fd == -1 && errno == ENOENT && create) {
+		fd = pool_open(name, O_EXCL | O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		created = fd != -1;
+		if(fd == -1 && errno == EEXIST) {
+			fd = pool_open(name, O_RDWR, 0); // lost the race
+		}
+	}
+	if(fd == -1) {
+		return -errno;
+	}
+	u64 size = created ? pool_size(classes, count) : 0;
+	if(created && ftruncate(fd, (off_t) size) == -1) {
+		i64 ret = -errno;
+		close(fd);
+		pool_unlink(name);
+		return ret;
+	}
+
+	// Attaching: wait for the creator to size the segment
+	u64 start = quicksand_now();
+	struct stat sb;
+	while(!created) {
+		if(fstat(fd, &sb) < 0) {
+			close(fd);
+			return -EIO;
+		}
+		if(sb.st_size >= (off_t) sizeof(quicksand_pool_header)
+		   || quicksand_ns(quicksand_now(), start) > POOL_TIMEOUT) {
+			size = (u64) sb.st_size;
+			break;
+		}
+		sched_yield();
+	}
+	if(size < sizeof(quicksand_pool_header)) {
+		close(fd);
+		return -EINVAL;
+	}
+	void *addr = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED) {
+		close(fd);
+		return -ENOMEM;
+	}
+	quicksand_pool_header *h = (quicksand_pool_header *) addr;
+	if(created) {
+		pool_format(h, classes, count);
+	}
+
+	// Check the format and, if the caller gave one, the geometry
+	u64 magic;
+	while((magic = atomic_load_explicit(&h->magic, memory_order_acquire)) == 0
+	      && quicksand_ns(quicksand_now(), start) < POOL_TIMEOUT) {
+		sched_yield();
+	}
+	i64 ret = 0;
+	if(magic != QUICKSAND_POOL_MAGIC) {
+		ret = -EBADMSG;
+	} else if(h->version != QUICKSAND_POOL_VERSION) {
+		ret = -EPROTO;
+	} else if(h->classes > QUICKSAND_POOL_CLASSES || !h->classes || !h->count
+		  || h->count > POOL_MAX_COUNT
+		  || size != pool_size((i64) h->classes, (i64) h->count)
+		  || (create && (h->classes != (u64) classes || h->count != (u64) count))) {
+		ret = -EINVAL;
+	}
+	quicksand_pool *pool = ret ? NULL : calloc(1, sizeof(quicksand_pool));
+	if(!pool) {
+		munmap(addr, (size_t) size);
+		close(fd);
+		return ret ? ret : -ENOMEM;
+	}
+	pool->header = h;
+	pool->size = size;
+	pool->fd = fd;
+	pool->entries = (quicksand_pool_entry *) ((u8 *) h + pool_entries_offset());
+	*out = pool;
+	return 0;
+}
+
+// Free list operations (entry indices, POOL_INDEX when empty)
+static u64 pool_pop(quicksand_pool *pool, quicksand_pool_class *c)
+{
+	u64 head = atomic_load_explicit(&c->free, memory_order_acquire);
+	for(;;) {
+		u64 top = head & POOL_INDEX;
+		if(!top) {
+			return POOL_INDEX;
+		}
+		// (next may be stale if top was taken meanwhile: the tag catches it)
+		u64 next = atomic_load_explicit(&pool->entries[top - 1].next, memory_order_relaxed);
+		u64 tagged = (((head >> 32) + 1) << 32) | next;
+		if(atomic_compare_exchange_weak_explicit(&c->free, &head, tagged,
+							 memory_order_acquire, memory_order_acquire)) {
+			return top - 1;
+		}
+	}
+}
+
+static void pool_push(quicksand_pool *pool, quicksand_pool_class *c, u64 entry)
+{
+	u64 head = atomic_load_explicit(&c->free, memory_order_relaxed);
+	for(;;) {
+		atomic_store_explicit(&pool->entries[entry].next, head & POOL_INDEX,
+				      memory_order_relaxed);
+		u64 tagged = (((head >> 32) + 1) << 32) | (entry + 1);
+		if(atomic_compare_exchange_weak_explicit(&c->free, &head, tagged,
+							 memory_order_release, memory_order_relaxed)) {
+			return;
+		}
+	}
+}
+
+// Class and entry of a handle, or null if it points nowhere valid
+static quicksand_pool_class *pool_find(quicksand_pool *pool, quicksand_blob *blob,
+					u64 *entry)
+{
+	quicksand_pool_header *h = pool->header;
+	for(u64 k = 0; k < h->classes; k += 1) {
+		quicksand_pool_class *c = &h->class[k];
+		if(blob->offset < c->offset || blob->offset >= c->offset + c->size * c->count) {
+			continue;
+		}
+		u64 index = (blob->offset - c->offset) / c->size;
+		if(blob->offset != c->offset + index * c->size || blob->length > c->size) {
+			return NULL;
+		}
+		*entry = c->first + index;
+		return c;
+	}
+	return NULL;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_release – drop a reference (the last one frees the blob)
+// ---------------------------------------------------------------------
+void quicksand_pool_release(quicksand_pool *pool, quicksand_blob *blob)
+{
+	u64 entry;
+	quicksand_pool_class *c = pool && blob ? pool_find(pool, blob, &entry) : NULL;
+	if(c && atomic_fetch_sub_explicit(&pool->entries[entry].refs, 1, memory_order_acq_rel) == 1) {
+		pool_push(pool, c, entry);
+	}
+}
+
+// Stop keeping the oldest published blob readable
+static i64 pool_retire(quicksand_pool *pool)
+{
+	if(pool->retain_head == pool->retain_tail) {
+		return 0;
+	}
+	quicksand_pool_release(pool, &pool->retained[pool->retain_head % QUICKSAND_POOL_RETAIN]);
+	pool->retain_head += 1;
+	return 1;
+}
+
+// Give up the oldest retained blob of one class (keeping the others in order)
+static i64 pool_retire_class(quicksand_pool *pool, quicksand_pool_class *c)
+{
+	u64 entry;
+	for(u64 i = pool->retain_head; i != pool->retain_tail; i += 1) {
+		quicksand_blob *blob = &pool->retained[i % QUICKSAND_POOL_RETAIN];
+		if(pool_find(pool, blob, &entry) != c) {
+			continue;
+		}
+		quicksand_pool_release(pool, blob);
+		for(; i != pool->retain_head; i -= 1) {
+			pool->retained[i % QUICKSAND_POOL_RETAIN] =
+				pool->retained[(i - 1) % QUICKSAND_POOL_RETAIN];
+		}
+		pool->retain_head += 1;
+		return 1;
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_alloc – take a free blob of the smallest fitting class
+// ---------------------------------------------------------------------
+i64 quicksand_pool_alloc(quicksand_pool *pool, i64 size, quicksand_blob *blob, u8 **data)
+{
+	if(!pool || !blob || !data || size < 0) {
+		return -EINVAL;
+	}
+	quicksand_pool_header *h = pool->header;
+	u64 k = 0;
+	while(k < h->classes && h->class[k].size < (u64) size) {
+		k += 1;
+	}
+	if(k == h->classes) {
+		return -EMSGSIZE;
+	}
+	quicksand_pool_class *c = &h->class[k];
+
+	// Out of blobs: give up the oldest ones of this class we still keep
+	// readable (other classes are not short of memory)
+	u64 entry;
+	while((entry = pool_pop(pool, c)) == POOL_INDEX) {
+		if(!pool_retire_class(pool, c)) {
+			return -ENOBUFS;
+		}
+	}
+	quicksand_pool_entry *e = &pool->entries[entry];
+	u64 generation = atomic_fetch_add_explicit(&e->generation, 1, memory_order_relaxed) + 1;
+	atomic_store_explicit(&e->refs, 1, memory_order_release);
+	blob->offset = c->offset + (entry - c->first) * c->size;
+	blob->length = (u64) size;
+	blob->generation = generation;
+	*data = (u8 *) h + blob->offset;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_publish – write a blob handle, keeping the blob readable
+// while the ring holds it
+// ---------------------------------------------------------------------
+i64 quicksand_pool_publish(quicksand_pool *pool, quicksand_connection *c, quicksand_blob *blob)
+{
+	if(!pool || !c || !blob) {
+		return -EINVAL;
+	}
+	i64 ret = quicksand_write(c, (u8 *) blob, sizeof(*blob));
+	if(ret) {
+		quicksand_pool_release(pool, blob);
+		return ret;
+	}
+	// The handle published mask + 1 writes ago has been overwritten by this
+	// one: a reader that had not acquired its blob by then (quicksand_pool_read
+	// acquires before handing the slot back) gets -ESTALE
+	u64 depth = c->mask + 1 < QUICKSAND_POOL_RETAIN ? c->mask + 1 : QUICKSAND_POOL_RETAIN;
+	while(pool->retain_tail - pool->retain_head >= depth) {
+		pool_retire(pool);
+	}
+	pool->retained[pool->retain_tail % QUICKSAND_POOL_RETAIN] = *blob;
+	pool->retain_tail += 1;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_acquire – reference a blob read from the ring
+// ---------------------------------------------------------------------
+i64 quicksand_pool_acquire(quicksand_pool *pool, quicksand_blob *blob, u8 **data)
+{
+	u64 entry;
+	quicksand_pool_class *c = pool && blob && data ? pool_find(pool, blob, &entry) : NULL;
+	if(!c) {
+		return -EINVAL;
+	}
+	quicksand_pool_entry *e = &pool->entries[entry];
+	u64 refs = atomic_load_explicit(&e->refs, memory_order_relaxed);
+	do {
+		if(!refs) {
+			return -ESTALE; // freed (never revive it)
+		}
+	} while(!atomic_compare_exchange_weak_explicit(&e->refs, &refs, refs + 1,
+						       memory_order_acquire, memory_order_relaxed));
+	if(atomic_load_explicit(&e->generation, memory_order_acquire) != blob->generation) {
+		quicksand_pool_release(pool, blob); // reused since: not ours
+		return -ESTALE;
+	}
+	*data = (u8 *) pool->header + blob->offset;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_read – read the next handle and acquire its blob while
+// the ring still holds it
+// ---------------------------------------------------------------------
+i64 quicksand_pool_read(quicksand_pool *pool, quicksand_connection *c, quicksand_blob *blob,
+			u8 **data)
+{
+	if(!pool || !c || !blob || !data) {
+		return -EINVAL;
+	}
+	for(;;) {
+		u64 end = 0;
+		i64 ret = _quicksand_pending(c, &end);
+		if(ret <= 0) {
+			return ret < 0 ? ret : -1; // (as quicksand_read when caught up)
+		}
+		u64 index = c->read_index;
+		u8 *payload = NULL;
+		u64 stamp = 0;
+		i64 length = _quicksand_peek(c, index, &payload, &stamp);
+		if(length == QUICKSAND_SLOT_ABANDONED) {
+			_quicksand_consume(c, index + 1);
+			continue; // (a dead writer's slot)
+		}
+		if(length != (i64) sizeof(*blob)) {
+			_quicksand_consume(c, index + 1);
+			return length < 0 ? length : -EBADMSG;
+		}
+		memcpy(blob, payload, sizeof(*blob));
+		ret = quicksand_pool_acquire(pool, blob, data);
+
+		// The copy only counts if no writer reserved the slot meanwhile
+		// (registered readers hold it until consumed, so they always
+		// acquire; others may have been lapped)
+		atomic_thread_fence(memory_order_acquire);
+		u64 reserve = atomic_load_explicit(&c->buffer->reserve, memory_order_relaxed);
+		if(reserve - index > c->mask + 1) {
+			if(!ret) {
+				quicksand_pool_release(pool, blob);
+			}
+			ret = -ESTALE;
+		}
+		_quicksand_consume(c, index + 1);
+		return ret ? ret : (i64) (end - index - 1);
+	}
+}
+
+// ---------------------------------------------------------------------
+// quicksand_pool_close – release what this process kept and unmap
+// ---------------------------------------------------------------------
+void quicksand_pool_close(quicksand_pool **pool)
+{
+	if(!pool || !*pool) {
+		return;
+	}
+	while(pool_retire(*pool)) {
+	}
+	munmap((void *) (*pool)->header, (size_t) (*pool)->size);
+	close((int) (*pool)->fd);
+	free(*pool);
+	*pool = NULL;
+}
+
+// ---------------------------------------------------------------------
+// internal - remove a topic's pool with the topic (quicksand_delete)
+// ---------------------------------------------------------------------
+void _quicksand_pool_unlink(const char *topic)
+{
+	char name[256 + 8];
+	pool_name(name, sizeof(name), topic);
+	pool_unlink(name);
+}
@@ -14,27 +14,42 @@
 // -------------------------------------------------------------------------
 
 #define _POSIX_C_SOURCE 200809L // for shm_open, ftruncate, etc.
+#define _DEFAULT_SOURCE		// for syscall (futex)
 
 #include "quicksand.h"
+#include "quicksand_internal.h"
 #include "quicksand_style.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sched.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
-#define QUICKSAND_TIMEOUT 250e6 // nanoseconds
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
-#define DEBUG 1
+#define QUICKSAND_RECOVER 20e3	// nanoseconds stalled before checking owner
 
-#if DEBUG
-#include <stdio.h>
-#endif
+#define QUICKSAND_GROWING UINT64_MAX // successor while a new ring is built
+#define QUICKSAND_REVIVING 1	     // boot while a file topic is being reset
 
+_Static_assert(sizeof(quicksand_ringbuffer) % QUICKSAND_LINE == 0,
+	       "ring header must end on a line pair (slots start aligned)");
+_Static_assert(sizeof(quicksand_alias_segment) < sizeof(quicksand_ringbuffer),
+	       "alias segments are told apart from rings by their size");
 
 #if defined(__GNUC__) || defined(__clang__)
 #define RESTRICT __restrict__
@@ -113,12 +128,448 @@ static inline void copy_topic_to_name(quicksand_connection *c, const char *topic
 	fast_memcpy(c->name, (u8 *) topic, copy_len);
 }
 
+// ---------------------------------------------------------------------
+// Helper – bounded copy of a caller-supplied topic name (topic_length -1
+//          to use strlen) into a 256-byte, null terminated buffer
+// ---------------------------------------------------------------------
+static inline void _quicksand_name(char *name, const char *topic, i64 topic_length)
+{
+	size_t max = topic_length < 0 || topic_length > 255 ? 255 : (size_t) topic_length;
+	size_t len = strnlen(topic, max);
+	memcpy(name, topic, len);
+	name[len] = 0;
+}
+
+// ---------------------------------------------------------------------
+// Helper – this process's pid, cached (and refreshed in forked children)
+// so connecting does not pay a system call for it
+// ---------------------------------------------------------------------
+static u64 PID = 0;
+static pthread_once_t PID_ONCE = PTHREAD_ONCE_INIT;
+
+static void _quicksand_pid_reset(void)
+{
+	PID = (u64) getpid();
+}
+
+static void _quicksand_pid_init(void)
+{
+	_quicksand_pid_reset();
+	pthread_atfork(NULL, NULL, _quicksand_pid_reset);
+}
+
+static inline u64 _quicksand_pid(void)
+{
+	pthread_once(&PID_ONCE, _quicksand_pid_init);
+	return PID;
+}
+
+// ---------------------------------------------------------------------
+// Helper – fill a freshly mapped connection object
+// ---------------------------------------------------------------------
+static i64 _quicksand_claim(quicksand_ringbuffer *rb, u64 role);
+
+// Snapshot the ring geometry (fixed for the life of a segment) so the
+// hot paths only touch the shared cursor lines
+static void _quicksand_geometry(quicksand_connection *c)
+{
+	quicksand_ringbuffer *rb = c->buffer;
+	c->data = (u8 *) rb + round_to_64((i64) sizeof(quicksand_ringbuffer));
+	c->mask = rb->length - 1;
+	c->stride = rb->message_size;
+	c->max_payload = (i64) rb->message_size - QUICKSAND_SLOT_HEADER;
+	c->sync = (i64) rb->sync;
+}
+
+static void init_connection(quicksand_connection *c, int fd, u64 size,
+			    quicksand_ringbuffer *rb, const char *name, u64 role)
+{
+	c->read_stamp = quicksand_now();
+	c->read_index = 0;
+	c->shared_memory_handle = (u64) fd;
+	c->shared_memory_size = size;
+	c->buffer = rb;
+	_quicksand_geometry(c);
+	c->pid = _quicksand_pid();
+	c->grow = 0;
+	c->peer_slot = _quicksand_claim(rb, role);
+	c->backpressure = QUICKSAND_BLOCK;
+	c->spill = NULL;
+	c->spill_size = 0;
+	c->spill_head = 0;
+	c->spill_tail = 0;
+	c->claim = NULL;
+	c->claim_index = 0;
+	c->claim_size = 0;
+	c->wait_spin_ns = 10e3;
+	c->wait_yield_ns = 100e3;
+	c->wait_sleep_ns = 1e6;
+	c->arrival_ns = 0.0;
+	c->arrival_stamp = 0;
+	c->latency = NULL;
+	copy_topic_to_name(c, name, (i64) strlen(name));
+}
+
+// ---------------------------------------------------------------------
+// Topic backends: names with a '/' after the first character are regular
+// files (POSIX shm names cannot contain one), all others shared memory
+// ---------------------------------------------------------------------
+static inline int _quicksand_is_file(const char *name)
+{
+	return name[0] && strchr(name + 1, '/') != NULL;
+}
+
+static int _quicksand_open(const char *name, int flags, mode_t mode)
+{
+	return _quicksand_is_file(name) ? open(name, flags | O_CLOEXEC, mode)
+					: shm_open(name, flags, mode);
+}
+
+static int _quicksand_unlink(const char *name)
+{
+	return _quicksand_is_file(name) ? unlink(name) : shm_unlink(name);
+}
+
+// Atomically replace a topic with another segment.  POSIX shm has no
+// rename, but on Linux its names are files under /dev/shm.
+static int _quicksand_rename(const char *from, const char *to)
+{
+	if(_quicksand_is_file(from)) {
+		return rename(from, to);
+	}
+	char from_path[256 + 16], to_path[256 + 16];
+	snprintf(from_path, sizeof(from_path), "/dev/shm/%s", from + (from[0] == '/'));
+	snprintf(to_path, sizeof(to_path), "/dev/shm/%s", to + (to[0] == '/'));
+	return rename(from_path, to_path);
+}
+
+// Clean up after a failed attach: files keep their (persistent) data
+static void _quicksand_discard(const char *name)
+{
+	if(!_quicksand_is_file(name)) {
+		shm_unlink(name);
+	}
+}
+
+// List a topic in the directory (replace: update a listed one's geometry)
+static void _quicksand_list(const char *name, quicksand_ringbuffer *rb, i64 replace)
+{
+	if(!rb->length) {
+		return; // (the creator lists it once initialized)
+	}
+	quicksand_topic_info info = {
+			.length = rb->length,
+			.message_size = rb->message_size - QUICKSAND_SLOT_HEADER,
+			.generation = rb->generation,
+			.type = rb->type};
+	_quicksand_directory_add(name, &info, replace);
+}
+
+// Identifier of the running boot (the stamps, locks and pids in a file
+// topic are meaningless after a reboot).  Never 0 or QUICKSAND_REVIVING.
+static u64 _quicksand_boot(void)
+{
+	static u64 boot = 0;
+	if(!boot) {
+		char id[64] = {0};
+		FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+		if(f) {
+			if(!fgets(id, sizeof(id), f)) {
+				id[0] = 0;
+			}
+			fclose(f);
+		}
+		u64 hash = 14695981039346656037ull; // FNV-1a
+		for(char *p = id; *p && *p != '\n'; p += 1) {
+			hash = (hash ^ (u8) *p) * 1099511628211ull;
+		}
+		boot = hash > QUICKSAND_REVIVING ? hash : hash + 2;
+	}
+	return boot;
+}
+
+// ---------------------------------------------------------------------
+// internal - reset the live state of a file topic last used before a
+// reboot: writer locks, in-flight reservations, peers and the clock.
+// The messages themselves are kept.  Returns 1 if this call reset it.
+// ---------------------------------------------------------------------
+static i64 _quicksand_revive(quicksand_ringbuffer *rb)
+{
+	u64 boot = _quicksand_boot();
+	u64 start = quicksand_now();
+	u64 seen;
+	for(;;) {
+		seen = atomic_load_explicit(&rb->boot, memory_order_acquire);
+		if(seen == boot) {
+			return 0;
+		}
+		if(seen == QUICKSAND_REVIVING
+		   && quicksand_ns(quicksand_now(), start) < QUICKSAND_TIMEOUT) {
+			sched_yield(); // another process is resetting it
+			continue;
+		}
+		if(atomic_compare_exchange_strong_explicit(&rb->boot, &seen, QUICKSAND_REVIVING,
+							   memory_order_acquire, memory_order_relaxed)) {
+			break;
+		}
+	}
+	u64 index = atomic_load_explicit(&rb->index, memory_order_relaxed);
+	atomic_store_explicit(&rb->reserve, index, memory_order_relaxed);
+	atomic_store_explicit(&rb->min_cursor, index, memory_order_relaxed);
+	atomic_store_explicit(&rb->waiters, 0, memory_order_relaxed);
+	atomic_store_explicit(&rb->updatestamp, 0, memory_order_relaxed);
+	atomic_store_explicit(&rb->locked, 0, memory_order_relaxed);
+	for(i64 i = 0; i < QUICKSAND_MAX_PEERS; i += 1) {
+		quicksand_peer *p = &rb->peers[i];
+		atomic_store_explicit(&p->role, 0, memory_order_relaxed);
+		atomic_store_explicit(&p->lag, 0, memory_order_relaxed);
+		atomic_store_explicit(&p->state, 0, memory_order_relaxed);
+	}
+	atomic_store_explicit(&rb->clock.sequence, 0, memory_order_relaxed);
+	quicksand_connection owner = {.buffer = rb};
+	quicksand_clock_update(&owner); // the old reference tick is gone
+	atomic_store_explicit(&rb->boot, boot, memory_order_release);
+	return 1;
+}
+
+// ---------------------------------------------------------------------
+// Process-wide mapping table: connections to the same topic from one
+// process share a single mapping (and fd), each with its own cursor.
+// ---------------------------------------------------------------------
+#define QUICKSAND_MAPPINGS 64
+
+typedef struct {
+	char name[256];
+	quicksand_ringbuffer *buffer;
+	u64 size;
+	int fd;
+	i64 refs; // 0 for a free entry
+} _quicksand_mapping;
+
+static _quicksand_mapping MAPPINGS[QUICKSAND_MAPPINGS];
+static pthread_mutex_t MAPPINGS_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+// Take a reference to this process's live mapping of a topic, or null.
+// Mappings of a topic that was deleted or grown since are not reused.
+static quicksand_ringbuffer *_quicksand_map_find(const char *name, int *fd,
+						 u64 *size)
+{
+	quicksand_ringbuffer *rb = NULL;
+	pthread_mutex_lock(&MAPPINGS_LOCK);
+	for(i64 i = 0; i < QUICKSAND_MAPPINGS && !rb; i += 1) {
+		_quicksand_mapping *m = &MAPPINGS[i];
+		struct stat sb;
+		if(m->refs == 0 || strcmp(m->name, name) != 0
+		   || atomic_load_explicit(&m->buffer->successor, memory_order_acquire)
+		   || fstat(m->fd, &sb) < 0 || sb.st_nlink == 0) {
+			continue;
+		}
+		m->refs += 1;
+		rb = m->buffer;
+		*fd = m->fd;
+		*size = m->size;
+	}
+	pthread_mutex_unlock(&MAPPINGS_LOCK);
+	return rb;
+}
+
+// Share a new mapping (it stays private if the table is full)
+static void _quicksand_map_add(const char *name, quicksand_ringbuffer *rb,
+			       u64 size, int fd)
+{
+	pthread_mutex_lock(&MAPPINGS_LOCK);
+	for(i64 i = 0; i < QUICKSAND_MAPPINGS; i += 1) {
+		_quicksand_mapping *m = &MAPPINGS[i];
+		if(m->refs == 0) {
+			_quicksand_name(m->name, name, -1);
+			m->buffer = rb;
+			m->size = size;
+			m->fd = fd;
+			m->refs = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&MAPPINGS_LOCK);
+}
+
+// Drop a reference, unmapping once no connection uses the mapping
+static void _quicksand_unmap(quicksand_ringbuffer *rb, u64 size, int fd)
+{
+	pthread_mutex_lock(&MAPPINGS_LOCK);
+	for(i64 i = 0; i < QUICKSAND_MAPPINGS; i += 1) {
+		_quicksand_mapping *m = &MAPPINGS[i];
+		if(m->refs > 0 && m->buffer == rb) {
+			m->refs -= 1;
+			if(m->refs > 0) {
+				pthread_mutex_unlock(&MAPPINGS_LOCK);
+				return;
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&MAPPINGS_LOCK);
+	munmap((void *) rb, (size_t) size);
+	close(fd);
+}
+
+// ---------------------------------------------------------------------
+// Helper – check the format of a mapped segment, giving a creator that
+// is still initializing it up to QUICKSAND_TIMEOUT to publish the magic
+// ---------------------------------------------------------------------
+static i64 _quicksand_validate(quicksand_ringbuffer *rb)
+{
+	u64 start = quicksand_now();
+	u64 magic;
+	while((magic = atomic_load_explicit(&rb->magic, memory_order_acquire)) == 0
+	      && quicksand_ns(quicksand_now(), start) < QUICKSAND_TIMEOUT) {
+		sched_yield();
+	}
+	if(magic != QUICKSAND_MAGIC) {
+		return -EBADMSG; // not a quicksand segment
+	}
+	if(rb->version != QUICKSAND_VERSION) {
+		return -EPROTO; // created with another header layout
+	}
+	if(rb->incompat & ~QUICKSAND_INCOMPAT_KNOWN) {
+		return -EPROTONOSUPPORT; // uses a feature we do not implement
+	}
+	if(rb->length > (u64) 1e12 || rb->message_size >= (u64) 1e12) {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+// Fill in the format fields last: attaching peers wait for the magic
+static void _quicksand_stamp_format(quicksand_ringbuffer *rb, u64 compat,
+				    u64 incompat)
+{
+	rb->version = QUICKSAND_VERSION;
+	rb->compat = compat;
+	rb->incompat = incompat;
+	atomic_store_explicit(&rb->magic, QUICKSAND_MAGIC, memory_order_release);
+}
+
+// ---------------------------------------------------------------------
+// Helper – read the target of an alias segment into name (256 bytes).
+// Returns 1 (connect to name instead) or -x for error.
+// ---------------------------------------------------------------------
+static i64 _quicksand_alias_read(int fd, char *name)
+{
+	void *addr = mmap(NULL, sizeof(quicksand_alias_segment), PROT_READ, MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED) {
+		return -ENOMEM;
+	}
+	quicksand_alias_segment *a = (quicksand_alias_segment *) addr;
+	u64 start = quicksand_now();
+	u64 magic;
+	while((magic = atomic_load_explicit(&a->magic, memory_order_acquire)) == 0
+	      && quicksand_ns(quicksand_now(), start) < QUICKSAND_TIMEOUT) {
+		sched_yield(); // (being created)
+	}
+	i64 ret = 1;
+	if(magic != QUICKSAND_MAGIC) {
+		ret = -EBADMSG;
+	} else if(a->version != QUICKSAND_VERSION) {
+		ret = -EPROTO;
+	} else if(!(a->incompat & QUICKSAND_INCOMPAT_ALIAS)
+		  || (a->incompat & ~QUICKSAND_INCOMPAT_KNOWN)) {
+		ret = -EPROTONOSUPPORT;
+	} else {
+		_quicksand_name(name, a->target, sizeof(a->target) - 1);
+	}
+	munmap(addr, sizeof(quicksand_alias_segment));
+	return ret;
+}
+
+// ---------------------------------------------------------------------
+// Helper – map an open topic descriptor and check its format.  Returns
+// 1 with the target in name if it is an alias.
+// ---------------------------------------------------------------------
+static i64 _quicksand_attach(char *name, int fd, quicksand_ringbuffer **out,
+			     u64 *size)
+{
+	struct stat sb;
+	if(fstat(fd, &sb) < 0) {
+		return -EIO;
+	}
+	if(sb.st_size == (off_t) sizeof(quicksand_alias_segment)) {
+		return _quicksand_alias_read(fd, name);
+	}
+	if(sb.st_size < (off_t) sizeof(quicksand_ringbuffer)) {
+		return -EINVAL; // too small
+	}
+
+	void *addr = mmap(NULL, (size_t) sb.st_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED) {
+		return -ENOMEM;
+	}
+	quicksand_ringbuffer *rb = (quicksand_ringbuffer *) addr;
+
+	// sanity‑check the meta‑data
+	i64 ret = _quicksand_validate(rb);
+	if(ret) {
+		munmap(addr, (size_t) sb.st_size);
+		return ret;
+	}
+	if(_quicksand_is_file(name)) {
+		_quicksand_revive(rb);
+	}
+	*out = rb;
+	*size = (u64) sb.st_size;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// Helper – connect a reader to a mapped topic (the mapping reference is
+// dropped on failure)
+// ---------------------------------------------------------------------
+static i64 _quicksand_attach_reader(quicksand_connection **out, char *name,
+				    int fd, u64 size, quicksand_ringbuffer *rb,
+				    quicksand_options *options,
+				    void *(*allocate)(size_t))
+{
+	// Readers that expect a payload type check it too
+	if(options && options->type && rb->type && rb->type != options->type) {
+		_quicksand_unmap(rb, size, fd);
+		return -EPROTOTYPE;
+	}
+
+	// Allocate out if null
+	if(!*out) {
+		*out = allocate(sizeof(quicksand_connection));
+	}
+	if(!*out) {
+		_quicksand_unmap(rb, size, fd);
+		return -ENOMEM;
+	}
+
+	// Fill the user‑supplied connection object.  Readers do not touch
+	// the directory: the creator listed the topic.
+	init_connection(*out, fd, size, rb, name, QUICKSAND_ROLE_READER);
+	_quicksand_clock_attach(*out);
+	return 0;
+}
+
 // ---------------------------------------------------------------------
 // quicksand_connect – create or attach to an existing shm segment
 // ---------------------------------------------------------------------
 i64 quicksand_connect(quicksand_connection **out, char *topic,
 		      i64 topic_length, i64 message_size,
 		      i64 message_rate, void *alloc)
+{
+	return quicksand_connect_options(out, topic, topic_length, message_size,
+					 message_rate, NULL, alloc);
+}
+
+static i64 _quicksand_connect(quicksand_connection **out, char *name_buf,
+			      i64 message_size, i64 message_rate,
+			      quicksand_options *options, void *(*allocate)(size_t));
+
+i64 quicksand_connect_options(quicksand_connection **out, char *topic,
+			      i64 topic_length, i64 message_size,
+			      i64 message_rate, quicksand_options *options,
+			      void *alloc)
 {
 	// -----------------------------------------------------------------
 	// Parameter validation
@@ -141,69 +592,54 @@ i64 quicksand_connect(quicksand_connection **out, char *topic,
 	// ---------------------------------------------------------------
 	// Build a null‑terminated C string from the caller‑supplied name.
 	// ---------------------------------------------------------------
-	char name_buf[256] = {0};
-	if(topic_length == -1) {
-		// -1 means “use strlen()”.  The original code behaved the same.
-		snprintf(name_buf, sizeof(name_buf), "%s", topic);
-	} else {
-		snprintf(name_buf, sizeof(name_buf), "%.*s", (int) topic_length,
-			 topic);
+	char name_buf[256];
+	_quicksand_name(name_buf, topic, topic_length);
+
+	// Aliases rewrite the name to their target: follow them
+	for(i64 hops = 0; hops <= QUICKSAND_ALIAS_HOPS; hops += 1) {
+		i64 ret = _quicksand_connect(out, name_buf, message_size, message_rate,
+					     options, allocate);
+		if(ret != 1) {
+			return ret;
+		}
 	}
+	return -ELOOP;
+}
 
+// ---------------------------------------------------------------------
+// internal - connect to the segment called name_buf.  Returns 1 (with
+// the target in name_buf) if that is an alias.
+// ---------------------------------------------------------------------
+static i64 _quicksand_connect(quicksand_connection **out, char *name_buf,
+			      i64 message_size, i64 message_rate,
+			      quicksand_options *options, void *(*allocate)(size_t))
+{
 	// ---------------------------------------------------------------
 	// If message_size == 0 || message_rate == 0 we are only *connecting*
 	// to an already existing segment.
 	// ---------------------------------------------------------------
 	if(message_size <= 0 || message_rate <= 0) {
-		int fd = shm_open(name_buf, O_RDWR, 0);
-		if(fd == -1) {
-			return -ENOENT; // segment does not exist
-		}
-
-		struct stat sb;
-		if(fstat(fd, &sb) < 0) {
-			close(fd);
-			return -EIO;
-		}
-		if(sb.st_size < (off_t) sizeof(quicksand_ringbuffer)) {
-			close(fd);
-			return -EINVAL; // too small
-		}
-
-		void *addr = mmap(NULL, (size_t) sb.st_size,
-				  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-		if(addr == MAP_FAILED) {
-			close(fd);
-			return -ENOMEM;
-		}
-
-		quicksand_ringbuffer *rb = (quicksand_ringbuffer *) addr;
-
-		// sanity‑check the meta‑data
-		if(rb->length > (u64) 1e12 || rb->message_size >= (u64) 1e12) {
-			munmap(addr, (size_t) sb.st_size);
-			close(fd);
-			return -EINVAL;
+		int fd = -1;
+		u64 size = 0;
+		quicksand_ringbuffer *rb = _quicksand_map_find(name_buf, &fd, &size);
+		if(!rb) {
+			fd = _quicksand_open(name_buf, O_RDWR, 0);
+			if(fd == -1) {
+				return -ENOENT; // segment does not exist
+			}
+			i64 ret = _quicksand_attach(name_buf, fd, &rb, &size);
+			if(ret) {
+				close(fd);
+				return ret; // (or 1 for an alias)
+			}
+			_quicksand_map_add(name_buf, rb, size, fd);
 		}
-
-		// Allocate out if null
-		if(!*out) {
-			*out = allocate(sizeof(quicksand_connection));
-		}
-		if(!*out) {
-			close(fd);
-			shm_unlink(name_buf);
-			return -ENOMEM;
+		i64 ret = _quicksand_attach_reader(out, name_buf, fd, size, rb, options,
+						   allocate);
+		if(ret == -ENOMEM) {
+			_quicksand_discard(name_buf);
 		}
-
-		// Fill the user‑supplied connection object
-		(*out)->read_stamp = quicksand_now();
-		(*out)->read_index = 0;
-		(*out)->shared_memory_handle = (u64) fd;
-		(*out)->shared_memory_size = (u64) sb.st_size;
-		(*out)->buffer = rb;
-		copy_topic_to_name(*out, name_buf, (i64) strlen(name_buf));
-		return 0;
+		return ret;
 	}
 
 	// ---------------------------------------------------------------
@@ -223,10 +659,17 @@ i64 quicksand_connect(quicksand_connection **out, char *topic,
 	// ---------------------------------------------------------------
 	i64 data_offset = round_to_64((i64) sizeof(quicksand_ringbuffer));
 
-	// reserve enough space for 1e9 ns (1 second) of messages.
-	// padded = [write_timestamp] + [message_len] + [message]
-	i64 padded_msg = round_to_64(8 + 8 + message_size);
-	i64 ring_length = round_to_pow2(message_rate);
+	// reserve enough space for 1e9 ns (1 second) of messages unless the
+	// caller asked for a depth in slots or in time.
+	// padded = [write_timestamp] + [message_len] + [owner] + [message]
+	i64 padded_msg = round_to_64(QUICKSAND_SLOT_HEADER + message_size);
+	i64 ring_slots = message_rate;
+	if(options && options->ring_length > 0) {
+		ring_slots = options->ring_length;
+	} else if(options && options->ring_ns > 0) {
+		ring_slots = (i64) ceil((f64) message_rate * (f64) options->ring_ns * 1e-9);
+	}
+	i64 ring_length = round_to_pow2(ring_slots < 2 ? 2 : ring_slots);
 	i64 payload_area = padded_msg * ring_length;
 	if(padded_msg < 0 || payload_area < 0) {
 		return -EINVAL;
@@ -236,42 +679,86 @@ i64 quicksand_connect(quicksand_connection **out, char *topic,
 	if(shm_size > (i64) INT64_MAX) {
 		return -EOVERFLOW;
 	}
+	i64 sync = options ? options->sync : QUICKSAND_SYNC_NONE;
+	if(sync < QUICKSAND_SYNC_NONE || sync > QUICKSAND_SYNC_FDATASYNC
+	   || (sync && !_quicksand_is_file(name_buf))) {
+		return -EINVAL; // only files can be synced
+	}
 
 	int already_exists = 0;
-	int fd = shm_open(name_buf, O_EXCL | O_CREAT | O_RDWR,
-			  S_IRUSR | S_IWUSR);
-	if(fd == -1 && errno == EEXIST) {
-		fd = shm_open(name_buf, O_RDWR, 0);
-		struct stat sb;
-		if(fstat(fd, &sb) < 0) {
-			close(fd);
-			return -EIO;
+	int created = 0;
+	int fd = -1;
+	u64 shared_size = 0;
+	void *addr = _quicksand_map_find(name_buf, &fd, &shared_size);
+	if(addr) {
+		already_exists = 1;
+		if(shared_size != (u64) shm_size) { // Abort if size does not match
+			if(!options || !options->grow) {
+				_quicksand_unmap(addr, shared_size, fd);
+				return -EINVAL;
+			}
+			shm_size = (i64) shared_size; // attach, then grow below
 		}
-		if(sb.st_size != shm_size) { // Abort if size does not match
-			close(fd);
-			return -EINVAL; // too small
+	} else {
+		// Most connects attach to an existing topic: try that first, and
+		// only create it (exclusively, another process may race us) when
+		// it is missing
+		fd = _quicksand_open(name_buf, O_RDWR, 0);
+		if(fd == -1 && errno == ENOENT) {
+			fd = _quicksand_open(name_buf, O_EXCL | O_CREAT | O_RDWR,
+					     S_IRUSR | S_IWUSR);
+			created = fd != -1;
+			if(fd == -1 && errno == EEXIST) {
+				fd = _quicksand_open(name_buf, O_RDWR, 0); // lost the race
+			}
+		}
+		if(fd != -1 && !created) {
+			struct stat sb;
+			if(fstat(fd, &sb) < 0) {
+				close(fd);
+				return -EIO;
+			}
+			if(sb.st_size == (off_t) sizeof(quicksand_alias_segment)) {
+				i64 ret = _quicksand_alias_read(fd, name_buf);
+				close(fd);
+				return ret; // 1: connect to the target
+			}
+			if(sb.st_size != shm_size) { // Abort if size does not match
+				if(!options || !options->grow
+				   || sb.st_size < (off_t) sizeof(quicksand_ringbuffer)) {
+					close(fd);
+					return -EINVAL; // too small
+				}
+				shm_size = (i64) sb.st_size; // attach, then grow below
+			}
+			already_exists = 1;
+		}
+		if(fd == -1) {
+			return -errno; // cannot create/open segment
 		}
-		already_exists = 1;
-	}
-	if(fd == -1) {
-		return -errno; // cannot create/open segment
-	}
 
-	// Resize the shm object to the required size
-	if(!already_exists) {
-		if(ftruncate(fd, (off_t) shm_size) == -1) {
-			close(fd);
-			shm_unlink(name_buf);
-			return -errno;
+		// Resize the shm object to the required size
+		if(!already_exists) {
+			if(ftruncate(fd, (off_t) shm_size) == -1) {
+				i64 ret = -errno;
+				close(fd);
+				_quicksand_unlink(name_buf);
+				return ret;
+			}
 		}
-	}
 
-	void *addr = mmap(NULL, (size_t) shm_size, PROT_READ | PROT_WRITE,
-			  MAP_SHARED, fd, 0);
-	if(addr == MAP_FAILED) {
-		close(fd);
-		shm_unlink(name_buf);
-		return -EINVAL;
+		addr = mmap(NULL, (size_t) shm_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+		if(addr == MAP_FAILED) {
+			close(fd);
+			if(already_exists) {
+				_quicksand_discard(name_buf);
+			} else {
+				_quicksand_unlink(name_buf);
+			}
+			return -EINVAL;
+		}
+		_quicksand_map_add(name_buf, addr, (u64) shm_size, fd);
 	}
 
 	// -----------------------------------------------------------------
@@ -279,17 +766,38 @@ i64 quicksand_connect(quicksand_connection **out, char *topic,
 	// a power‑of‑two (so that modulo can be replaced by & (len‑1)).
 	// -----------------------------------------------------------------
 	quicksand_ringbuffer *rb = (quicksand_ringbuffer *) addr;
+	i64 invalid = already_exists ? _quicksand_validate(rb) : 0;
 	if(!already_exists) {
 		rb->length = ring_length;
 		rb->message_size = padded_msg;
 		atomic_store_explicit(&rb->reserve, 0, memory_order_relaxed);
 		atomic_store_explicit(&rb->index, 0, memory_order_relaxed);
 		atomic_store_explicit(&rb->updatestamp, 0, memory_order_relaxed);
-	} else if(rb->length != (u64) ring_length
-		  || rb->message_size < (u64) padded_msg) {
-		close(fd);
-		shm_unlink(name_buf);
+		atomic_store_explicit(&rb->min_cursor, 0, memory_order_relaxed);
+		rb->generation = 0;
+		atomic_store_explicit(&rb->successor, 0, memory_order_relaxed);
+		rb->sync = (u64) sync;
+		atomic_store_explicit(&rb->boot,
+				      _quicksand_is_file(name_buf) ? _quicksand_boot() : 0,
+				      memory_order_relaxed);
+		rb->type = options ? options->type : 0;
+		_quicksand_stamp_format(rb, (sync ? QUICKSAND_COMPAT_SYNC : 0)
+						    | (rb->type ? QUICKSAND_COMPAT_TYPE : 0),
+					0);
+	} else if(invalid) {
+		_quicksand_unmap(rb, (u64) shm_size, fd);
+		return invalid;
+	} else if(options && options->type && rb->type && rb->type != options->type) {
+		_quicksand_unmap(rb, (u64) shm_size, fd);
+		return -EPROTOTYPE;
+	} else if((rb->length != (u64) ring_length
+		   || rb->message_size < (u64) padded_msg)
+		  && !(options && options->grow)) {
+		_quicksand_unmap(rb, (u64) shm_size, fd);
+		_quicksand_discard(name_buf);
 		return -EINVAL;
+	} else if(_quicksand_is_file(name_buf)) {
+		_quicksand_revive(rb);
 	}
 
 	// Allocate out if null
@@ -297,22 +805,133 @@ i64 quicksand_connect(quicksand_connection **out, char *topic,
 		*out = allocate(sizeof(quicksand_connection));
 	}
 	if(!*out) {
-		close(fd);
-		shm_unlink(name_buf);
+		_quicksand_unmap(rb, (u64) shm_size, fd);
+		_quicksand_discard(name_buf);
 		return -ENOMEM;
 	}
 
 	// Fill the user‑supplied connection object
-	((*out)->read_stamp) = quicksand_now();
-	((*out)->read_index) = 0;
-	((*out)->shared_memory_handle) = (u64) fd;
-	((*out)->shared_memory_size) = (u64) shm_size;
-	((*out)->buffer) = rb;
-	copy_topic_to_name(*out, name_buf, (i64) strlen(name_buf));
+	init_connection(*out, fd, (u64) shm_size, rb, name_buf,
+			QUICKSAND_ROLE_WRITER);
+	(*out)->grow = options && options->grow;
+	if(already_exists) {
+		_quicksand_clock_attach(*out);
+	} else {
+		quicksand_clock_update(*out); // share our calibration
+	}
+	if(!already_exists) {
+		_quicksand_list(name_buf, rb, 1); // (attaching writers do not touch it)
+	}
 
+	// Grow a smaller existing topic (the connection stays attached to the
+	// existing ring if that fails)
+	if(already_exists
+	   && (rb->length < (u64) ring_length || rb->message_size < (u64) padded_msg)) {
+		return quicksand_grow(*out, message_size, ring_length);
+	}
 	return 0;
 }
 
+// ---------------------------------------------------------------------
+// quicksand_connect_fd – attach a reader through an open descriptor
+// ---------------------------------------------------------------------
+i64 quicksand_connect_fd(quicksand_connection **out, i64 fd, char *topic,
+			 void *alloc)
+{
+	if(fd < 0 || !topic) {
+		return -EINVAL;
+	}
+	void *(*allocate)(size_t) = malloc;
+	if(alloc) {
+		allocate = (void *(*) (size_t)) alloc;
+	}
+	char name_buf[256];
+	_quicksand_name(name_buf, topic, -1);
+
+	// The mapping stays private: the descriptor may name a segment this
+	// process cannot see under that name
+	int own = fcntl((int) fd, F_DUPFD_CLOEXEC, 0);
+	if(own == -1) {
+		return -errno;
+	}
+	quicksand_ringbuffer *rb = NULL;
+	u64 size = 0;
+	i64 ret = _quicksand_attach(name_buf, own, &rb, &size);
+	if(ret) {
+		close(own);
+		// An alias only holds a name: connect to its target as usual
+		return ret == 1 ? quicksand_connect(out, name_buf, -1, -1, -1, alloc) : ret;
+	}
+	return _quicksand_attach_reader(out, name_buf, own, size, rb, NULL, allocate);
+}
+
+// ---------------------------------------------------------------------
+// quicksand_send_topic – pass a topic descriptor over a unix socket
+// ---------------------------------------------------------------------
+i64 quicksand_send_topic(i64 socket, quicksand_connection *c)
+{
+	if(!c || c->shared_memory_handle <= 0) {
+		return -EINVAL;
+	}
+	int fd = (int) c->shared_memory_handle;
+	union {
+		struct cmsghdr header;
+		char data[CMSG_SPACE(sizeof(int))];
+	} control = {0};
+	struct iovec iov = {.iov_base = c->name, .iov_len = strlen((char *) c->name) + 1};
+	struct msghdr msg = {.msg_iov = &iov,
+			     .msg_iovlen = 1,
+			     .msg_control = control.data,
+			     .msg_controllen = sizeof(control.data)};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	ssize_t sent;
+	while((sent = sendmsg((int) socket, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR) {
+	}
+	return sent == -1 ? -errno : 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_recv_topic – connect a reader to a topic passed by
+// quicksand_send_topic
+// ---------------------------------------------------------------------
+i64 quicksand_recv_topic(i64 socket, quicksand_connection **out, void *alloc)
+{
+	char name[256] = {0};
+	union {
+		struct cmsghdr header;
+		char data[CMSG_SPACE(sizeof(int))];
+	} control = {0};
+	struct iovec iov = {.iov_base = name, .iov_len = sizeof(name) - 1};
+	struct msghdr msg = {.msg_iov = &iov,
+			     .msg_iovlen = 1,
+			     .msg_control = control.data,
+			     .msg_controllen = sizeof(control.data)};
+	ssize_t got;
+	while((got = recvmsg((int) socket, &msg, 0)) == -1 && errno == EINTR) {
+	}
+	if(got == -1) {
+		return -errno;
+	}
+	int fd = -1;
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if(cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+	   && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+		memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	if(fd < 0) {
+		return got == 0 ? -EPIPE : -EBADMSG; // closed, or not a topic
+	}
+	i64 ret = (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || !got || name[got - 1]
+			  ? -EBADMSG
+			  : quicksand_connect_fd(out, fd, name, alloc);
+	close(fd);
+	return ret;
+}
+
 // ---------------------------------------------------------------------
 // quicksand_disconnect – undo everything done in quicksand_connect
 // ---------------------------------------------------------------------
@@ -322,10 +941,18 @@ void quicksand_disconnect(quicksand_connection **c, void *dealloc)
 		return;
 	}
 
+	if((*c)->claim) {
+		quicksand_commit(*c, -1); // do not leave the slot to recovery
+	}
+	if((*c)->peer_slot >= 0) {
+		atomic_store_explicit(&(*c)->buffer->peers[(*c)->peer_slot].state, 0,
+				      memory_order_release);
+		(*c)->peer_slot = -1;
+	}
 	if((*c)->shared_memory_handle > 0) {
-		// Unmap the segment first
-		munmap((void *) (*c)->buffer, (size_t) (*c)->shared_memory_size);
-		close((int) (*c)->shared_memory_handle);
+		// Unmap the segment first (once no connection shares it)
+		_quicksand_unmap((*c)->buffer, (*c)->shared_memory_size,
+				 (int) (*c)->shared_memory_handle);
 		// shm_unlink((char*)(*c)->name); // removes the buffer for future
 		// use quicksand_delete(name, namelen) instead
 	}
@@ -342,25 +969,292 @@ void quicksand_disconnect(quicksand_connection **c, void *dealloc)
 
 void quicksand_delete(char *topic, i64 topic_length)
 {
-	char name_buf[256] = {0};
-	if(topic_length == -1) {
-		// -1 means “use strlen()”.  The original code behaved the same.
-		snprintf(name_buf, sizeof(name_buf), "%s", topic);
-	} else {
-		snprintf(name_buf, sizeof(name_buf), "%.*s", (int) topic_length,
-			 topic);
-	}
-	shm_unlink(name_buf);
+	char name_buf[256];
+	_quicksand_name(name_buf, topic, topic_length);
+	_quicksand_unlink(name_buf);
+	_quicksand_directory_remove(name_buf);
+	_quicksand_pool_unlink(name_buf);
 }
 
 // ---------------------------------------------------------------------
-// internal - attempt to un-lock a stalled ringbuffer.
+// quicksand_alias – give a topic another name
 // ---------------------------------------------------------------------
-static i64 _quicksand_unlock(quicksand_ringbuffer *ring, u64 locktime)
+i64 quicksand_alias(char *alias, char *topic)
 {
-	u64 now = quicksand_now();
-	if(!ring) {
-		return -1;
+	if(!alias || !topic || !alias[0] || !topic[0]) {
+		return -EINVAL;
+	}
+	char name[256], target[256] = {0};
+	_quicksand_name(name, alias, -1);
+	_quicksand_name(target, topic, -1);
+	if(strcmp(name, target) == 0) {
+		return -ELOOP;
+	}
+
+	int fd = _quicksand_open(name, O_EXCL | O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if(fd == -1) {
+		if(errno != EEXIST) {
+			return -errno;
+		}
+		// Recreating the same alias is not an error
+		char existing[256];
+		struct stat sb;
+		i64 ret = -EEXIST;
+		fd = _quicksand_open(name, O_RDONLY, 0);
+		if(fd != -1 && fstat(fd, &sb) == 0 && sb.st_size == (off_t) sizeof(quicksand_alias_segment)
+		   && _quicksand_alias_read(fd, existing) == 1 && strcmp(existing, target) == 0) {
+			ret = 0;
+		}
+		if(fd != -1) {
+			close(fd);
+		}
+		return ret;
+	}
+	if(ftruncate(fd, sizeof(quicksand_alias_segment)) == -1) {
+		i64 ret = -errno;
+		close(fd);
+		_quicksand_unlink(name);
+		return ret;
+	}
+	void *addr = mmap(NULL, sizeof(quicksand_alias_segment), PROT_READ | PROT_WRITE,
+			  MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED) {
+		_quicksand_unlink(name);
+		return -ENOMEM;
+	}
+
+	// Format last: connecting peers wait for the magic
+	quicksand_alias_segment *a = (quicksand_alias_segment *) addr;
+	memcpy(a->target, target, sizeof(target));
+	a->version = QUICKSAND_VERSION;
+	a->compat = 0;
+	a->incompat = QUICKSAND_INCOMPAT_ALIAS;
+	atomic_store_explicit(&a->magic, QUICKSAND_MAGIC, memory_order_release);
+	munmap(addr, sizeof(quicksand_alias_segment));
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_sync – write a file-backed topic out to its file
+// ---------------------------------------------------------------------
+i64 quicksand_sync(quicksand_connection *c)
+{
+	if(!c || !c->buffer || !_quicksand_is_file((char *) c->name)) {
+		return -EINVAL;
+	}
+	return fdatasync((int) c->shared_memory_handle) == 0 ? 0 : -errno;
+}
+
+// ---------------------------------------------------------------------
+// internal - map the segment that replaced a connection's ring
+// (-EAGAIN until the growth is complete and visible)
+// ---------------------------------------------------------------------
+static i64 _quicksand_successor(quicksand_connection *c, quicksand_ringbuffer **out,
+				int *fd, u64 *size)
+{
+	u64 successor = atomic_load_explicit(&c->buffer->successor, memory_order_seq_cst);
+	if(successor == 0 || successor == QUICKSAND_GROWING) {
+		return -EAGAIN;
+	}
+	quicksand_ringbuffer *rb = _quicksand_map_find((char *) c->name, fd, size);
+	if(!rb) {
+		*fd = _quicksand_open((char *) c->name, O_RDWR, 0);
+		if(*fd == -1) {
+			return -EAGAIN; // replacement not visible yet
+		}
+		struct stat sb;
+		if(fstat(*fd, &sb) < 0 || sb.st_size < (off_t) sizeof(quicksand_ringbuffer)) {
+			close(*fd);
+			return -EAGAIN;
+		}
+		void *addr = mmap(NULL, (size_t) sb.st_size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED, *fd, 0);
+		if(addr == MAP_FAILED) {
+			close(*fd);
+			return -ENOMEM;
+		}
+		rb = (quicksand_ringbuffer *) addr;
+		if(_quicksand_validate(rb) || rb->generation < successor) {
+			munmap(addr, (size_t) sb.st_size);
+			close(*fd);
+			return -EAGAIN;
+		}
+		*size = (u64) sb.st_size;
+		_quicksand_map_add((char *) c->name, rb, *size, *fd);
+	}
+	*out = rb;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - move a connection to the segment that replaced its ring.
+// Readers call this only once they drained the old ring.
+// ---------------------------------------------------------------------
+static i64 _quicksand_remap(quicksand_connection *c)
+{
+	quicksand_ringbuffer *old = c->buffer;
+	quicksand_ringbuffer *rb = NULL;
+	int fd = -1;
+	u64 size = 0;
+	i64 ret = _quicksand_successor(c, &rb, &fd, &size);
+	if(ret) {
+		return ret;
+	}
+
+	// Carry our registry entry (and lossless registration) over
+	u64 role = QUICKSAND_ROLE_READER;
+	if(c->peer_slot >= 0) {
+		quicksand_peer *p = &old->peers[c->peer_slot];
+		role = atomic_load_explicit(&p->role, memory_order_relaxed);
+		atomic_store_explicit(&p->state, 0, memory_order_release);
+	}
+	_quicksand_unmap(old, c->shared_memory_size, (int) c->shared_memory_handle);
+
+	c->shared_memory_handle = (u64) fd;
+	c->shared_memory_size = size;
+	c->buffer = rb;
+	_quicksand_geometry(c);
+	c->read_index = 0;
+	c->read_stamp = quicksand_now();
+	if(role & QUICKSAND_ROLE_RELIABLE) {
+		quicksand_peer *p = &rb->peers[c->peer_slot]; // kept by the grower
+		if(atomic_load_explicit(&p->state, memory_order_acquire) == 2
+		   && p->pid == c->pid
+		   && atomic_load_explicit(&p->role, memory_order_relaxed) & QUICKSAND_ROLE_RELIABLE) {
+			return 0;
+		}
+	}
+	c->peer_slot = _quicksand_claim(rb, role & ~(u64) QUICKSAND_ROLE_RELIABLE);
+	if(role & QUICKSAND_ROLE_RELIABLE) {
+		quicksand_register(c);
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - wait for an in-progress growth and follow it
+// ---------------------------------------------------------------------
+static i64 _quicksand_follow(quicksand_connection *c)
+{
+	u64 start = quicksand_now();
+	i64 ret;
+	while((ret = _quicksand_remap(c)) == -EAGAIN) {
+		if(quicksand_ns(quicksand_now(), start) > QUICKSAND_TIMEOUT) {
+			return -ETIMEDOUT;
+		}
+	}
+	return ret;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_grow – replace the topic with a larger segment
+// ---------------------------------------------------------------------
+i64 quicksand_grow(quicksand_connection *c, i64 message_size, i64 ring_length)
+{
+	if(!c || !c->buffer) {
+		return -EINVAL;
+	}
+	quicksand_ringbuffer *rb = c->buffer;
+	if(atomic_load_explicit(&rb->successor, memory_order_acquire)) {
+		i64 ret = _quicksand_follow(c); // someone else grew it first
+		return ret ? ret : quicksand_grow(c, message_size, ring_length);
+	}
+
+	u64 padded_msg = (u64) round_to_64(QUICKSAND_SLOT_HEADER + message_size);
+	u64 length = (u64) round_to_pow2(ring_length);
+	padded_msg = padded_msg > rb->message_size ? padded_msg : rb->message_size;
+	length = length > rb->length ? length : rb->length;
+	if(padded_msg == rb->message_size && length == rb->length) {
+		return 0; // already large enough
+	}
+	i64 shm_size = round_to_64((i64) sizeof(quicksand_ringbuffer))
+			+ (i64) (padded_msg * length);
+
+	// Only one process builds the replacement
+	u64 expected = 0;
+	if(!atomic_compare_exchange_strong_explicit(&rb->successor, &expected,
+						    QUICKSAND_GROWING, memory_order_seq_cst, memory_order_relaxed)) {
+		i64 ret = _quicksand_follow(c);
+		return ret ? ret : quicksand_grow(c, message_size, ring_length);
+	}
+
+	// Build the replacement under a temporary name and rename it over the
+	// topic, so the name never points at nothing (the old segment stays
+	// mapped by its peers) and a failure leaves the old topic in place
+	char *name = (char *) c->name;
+	char building[256 + 8];
+	snprintf(building, sizeof(building), "%s.grow", name);
+	_quicksand_unlink(building); // left by a grower that died
+	int fd = _quicksand_open(building, O_EXCL | O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if(fd == -1 || ftruncate(fd, (off_t) shm_size) == -1) {
+		i64 ret = -errno;
+		if(fd != -1) {
+			close(fd);
+			_quicksand_unlink(building);
+		}
+		atomic_store_explicit(&rb->successor, 0, memory_order_seq_cst);
+		return ret;
+	}
+	void *addr = mmap(NULL, (size_t) shm_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, fd, 0);
+	if(addr == MAP_FAILED) {
+		close(fd);
+		_quicksand_unlink(building);
+		atomic_store_explicit(&rb->successor, 0, memory_order_seq_cst);
+		return -ENOMEM;
+	}
+	quicksand_ringbuffer *next = (quicksand_ringbuffer *) addr;
+	next->length = length;
+	next->message_size = padded_msg;
+	next->generation = rb->generation + 1;
+	next->sync = rb->sync;
+	next->type = rb->type;
+	atomic_store_explicit(&next->boot, atomic_load(&rb->boot), memory_order_relaxed);
+	next->clock.sequence = _quicksand_clock_read(&rb->clock, &next->clock);
+
+	// Registered readers keep their entry (at the same index) so writers
+	// on the new ring wait for them while they drain the old one.  A
+	// reader registering meanwhile either shows up here or sees successor
+	// set and carries its entry over itself (_quicksand_carry).
+	for(i64 i = 0; i < QUICKSAND_MAX_PEERS; i += 1) {
+		quicksand_peer *p = &rb->peers[i];
+		u64 role = atomic_load_explicit(&p->role, memory_order_seq_cst);
+		if(atomic_load_explicit(&p->state, memory_order_acquire) != 2
+		   || !(role & QUICKSAND_ROLE_RELIABLE)) {
+			continue;
+		}
+		quicksand_peer *q = &next->peers[i];
+		q->pid = p->pid;
+		atomic_store_explicit(&q->tick, atomic_load(&p->tick), memory_order_relaxed);
+		atomic_store_explicit(&q->role, role, memory_order_relaxed);
+		atomic_store_explicit(&q->state, 2, memory_order_relaxed);
+	}
+	_quicksand_stamp_format(next, rb->compat, rb->incompat);
+	i64 ret = _quicksand_rename(building, name) == -1 ? -errno : 0;
+	if(ret) {
+		_quicksand_unlink(building);
+	} else {
+		_quicksand_list(name, next, 1);
+	}
+	munmap(addr, (size_t) shm_size);
+	close(fd);
+	if(ret) {
+		atomic_store_explicit(&rb->successor, 0, memory_order_seq_cst);
+		return ret;
+	}
+	atomic_store_explicit(&rb->successor, rb->generation + 1, memory_order_seq_cst);
+	return _quicksand_follow(c);
+}
+
+// ---------------------------------------------------------------------
+// internal - attempt to un-lock a stalled ringbuffer.
+// ---------------------------------------------------------------------
+static i64 _quicksand_unlock(quicksand_ringbuffer *ring, u64 locktime)
+{
+	u64 now = quicksand_now();
+	if(!ring) {
+		return -1;
 	}
 
 	// only if sufficient time passed, attempt unlock.
@@ -387,17 +1281,411 @@ static i64 _quicksand_unlock(quicksand_ringbuffer *ring, u64 locktime)
 
 
 // ---------------------------------------------------------------------
-// quicksand_write – put a new payload into the ring buffer
+// internal - claim a registry entry for this process
 // ---------------------------------------------------------------------
-i64 quicksand_write(quicksand_connection *c, u8 *msg, i64 msg_len)
+static i64 _quicksand_reap(quicksand_peer *p, u64 now);
+
+static i64 _quicksand_claim(quicksand_ringbuffer *rb, u64 role)
 {
-	u64 start_time = quicksand_now();
-	if(!c || !msg) {
+	u64 now = quicksand_now();
+	for(i64 i = 0; i < 2 * QUICKSAND_MAX_PEERS; i += 1) {
+		quicksand_peer *p = &rb->peers[i % QUICKSAND_MAX_PEERS];
+		u64 expected = 0;
+		if(!atomic_compare_exchange_strong_explicit(&p->state, &expected, 1,
+							    memory_order_acquire, memory_order_relaxed)) {
+			// table full: second pass releases entries of dead processes
+			if(i >= QUICKSAND_MAX_PEERS && expected == 2) {
+				i -= _quicksand_reap(p, now);
+			}
+			continue;
+		}
+		p->pid = _quicksand_pid();
+		atomic_store_explicit(&p->cursor, 0, memory_order_relaxed);
+		atomic_store_explicit(&p->tick, now, memory_order_relaxed);
+		atomic_store_explicit(&p->role, role, memory_order_relaxed);
+		atomic_store_explicit(&p->lag, 0, memory_order_relaxed);
+		atomic_store_explicit(&p->state, 2, memory_order_release);
+		return i % QUICKSAND_MAX_PEERS;
+	}
+	return -1;
+}
+
+// ---------------------------------------------------------------------
+// internal - release the entry of a peer whose process died.  Only
+// entries without a heartbeat for QUICKSAND_TIMEOUT are checked, so
+// live processes cost no syscalls.
+// ---------------------------------------------------------------------
+static i64 _quicksand_reap(quicksand_peer *p, u64 now)
+{
+	u64 tick = atomic_load_explicit(&p->tick, memory_order_relaxed);
+	if(quicksand_ns(now, tick) <= QUICKSAND_TIMEOUT) {
+		return 0;
+	}
+	if(kill((pid_t) p->pid, 0) == 0 || errno != ESRCH) {
+		return 0; // still running (or owned by another user)
+	}
+	u64 expected = 2;
+	atomic_compare_exchange_strong_explicit(&p->state, &expected, 0,
+						memory_order_release, memory_order_relaxed);
+	return 1;
+}
+
+// ---------------------------------------------------------------------
+// internal - refresh the activity tick (and role) of our registry entry
+// ---------------------------------------------------------------------
+static inline void _quicksand_touch(quicksand_connection *c, u64 role, u64 now)
+{
+	if(c->peer_slot < 0) {
+		return;
+	}
+	quicksand_peer *p = &c->buffer->peers[c->peer_slot];
+	atomic_store_explicit(&p->tick, now, memory_order_relaxed);
+	if(!(atomic_load_explicit(&p->role, memory_order_relaxed) & role)) {
+		atomic_fetch_or_explicit(&p->role, role, memory_order_relaxed);
+	}
+}
+
+void quicksand_heartbeat(quicksand_connection *c)
+{
+	if(c && c->buffer) {
+		_quicksand_touch(c, 0, quicksand_now());
+	}
+}
+
+i64 quicksand_peers(quicksand_connection *c, quicksand_peer *peers, i64 max_peers)
+{
+	if(!c || !c->buffer || (max_peers > 0 && !peers)) {
+		return -EINVAL;
+	}
+	quicksand_ringbuffer *rb = c->buffer;
+	u64 now = quicksand_now();
+	_quicksand_touch(c, 0, now);
+
+	i64 count = 0;
+	for(i64 i = 0; i < QUICKSAND_MAX_PEERS; i += 1) {
+		quicksand_peer *p = &rb->peers[i];
+		if(atomic_load_explicit(&p->state, memory_order_acquire) != 2
+		   || _quicksand_reap(p, now)) {
+			continue;
+		}
+		if(count < max_peers) {
+			peers[count] = *p;
+		}
+		count += 1;
+	}
+	return count;
+}
+
+// ---------------------------------------------------------------------
+// internal - add a registered entry to the segment replacing the ring,
+// at the same index, as the grower does for the readers it saw
+// ---------------------------------------------------------------------
+static void _quicksand_carry(quicksand_connection *c)
+{
+	quicksand_ringbuffer *old = c->buffer;
+	u64 start = quicksand_now();
+	while(atomic_load_explicit(&old->successor, memory_order_seq_cst) == QUICKSAND_GROWING
+	      && quicksand_ns(quicksand_now(), start) < QUICKSAND_TIMEOUT) {
+		sched_yield();
+	}
+	quicksand_ringbuffer *rb = NULL;
+	int fd = -1;
+	u64 size = 0;
+	if(_quicksand_successor(c, &rb, &fd, &size)) {
+		return; // the growth failed (or is stuck: remapping registers again)
+	}
+	quicksand_peer *p = &old->peers[c->peer_slot];
+	quicksand_peer *q = &rb->peers[c->peer_slot];
+	u64 expected = 0;
+	if(atomic_compare_exchange_strong_explicit(&q->state, &expected, 1, memory_order_acquire,
+						   memory_order_relaxed)) {
+		q->pid = p->pid;
+		atomic_store_explicit(&q->cursor, 0, memory_order_relaxed);
+		atomic_store_explicit(&q->tick, atomic_load(&p->tick), memory_order_relaxed);
+		atomic_store_explicit(&q->role, atomic_load(&p->role), memory_order_relaxed);
+		atomic_store_explicit(&q->lag, 0, memory_order_relaxed);
+		atomic_store_explicit(&q->state, 2, memory_order_release);
+	} // (else copied by the grower, or taken: remapping registers again)
+	_quicksand_unmap(rb, size, fd);
+}
+
+// ---------------------------------------------------------------------
+// quicksand_register – publish this reader's cursor to the writers
+// ---------------------------------------------------------------------
+i64 quicksand_register(quicksand_connection *c)
+{
+	if(!c || !c->buffer) {
+		return -EINVAL;
+	}
+	quicksand_ringbuffer *rb = c->buffer;
+	if(c->peer_slot < 0) { // table was full at connect, try again
+		c->peer_slot = _quicksand_claim(rb, QUICKSAND_ROLE_READER);
+		if(c->peer_slot < 0) {
+			return -ENOSPC;
+		}
+	}
+	quicksand_peer *p = &rb->peers[c->peer_slot];
+	if(atomic_load_explicit(&p->role, memory_order_relaxed) & QUICKSAND_ROLE_RELIABLE) {
+		return 0; // already registered
+	}
+
+	// Start from the head if the old messages are already unreadable
+	u64 index = atomic_load_explicit(&rb->index, memory_order_acquire);
+	if(index - c->read_index > rb->length / 2) {
+		c->read_index = index;
+	}
+	atomic_store_explicit(&p->cursor, c->read_index, memory_order_relaxed);
+	atomic_fetch_or_explicit(&p->role, QUICKSAND_ROLE_READER | QUICKSAND_ROLE_RELIABLE,
+				 memory_order_seq_cst);
+
+	// Writers only rescan when the cached minimum looks lapped, so
+	// pull the cached minimum back to our cursor if we start behind it.
+	u64 cached = atomic_load_explicit(&rb->min_cursor, memory_order_relaxed);
+	while((i64) (c->read_index - cached) < 0) {
+		if(atomic_compare_exchange_weak_explicit(&rb->min_cursor, &cached,
+							 c->read_index, memory_order_release, memory_order_relaxed)) {
+			break;
+		}
+	}
+	if(atomic_load_explicit(&rb->successor, memory_order_seq_cst)) {
+		_quicksand_carry(c); // the grower may have copied the registry before us
+	}
+	return 0;
+}
+
+void quicksand_unregister(quicksand_connection *c)
+{
+	if(!c || !c->buffer || c->peer_slot < 0) {
+		return;
+	}
+	quicksand_peer *p = &c->buffer->peers[c->peer_slot];
+	atomic_fetch_and_explicit(&p->role, ~(u64) QUICKSAND_ROLE_RELIABLE,
+				  memory_order_release);
+}
+
+i64 quicksand_backpressure(quicksand_connection *c, i64 policy, u8 *spill,
+			   i64 spill_size)
+{
+	if(!c || policy < QUICKSAND_LOSSY || policy > QUICKSAND_SPILL) {
+		return -EINVAL;
+	}
+	if(policy == QUICKSAND_SPILL && (!spill || spill_size < 16)) {
 		return -EINVAL;
 	}
+	if(c->spill_head != c->spill_tail) {
+		return -EBUSY; // queued messages would be lost
+	}
+	c->backpressure = policy;
+	c->spill = spill;
+	c->spill_size = spill ? (u64) spill_size : 0;
+	c->spill_head = 0;
+	c->spill_tail = 0;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - recompute the slowest registered reader cursor.
+// Readers only move forward, so a stale cached value is conservative.
+// Dead readers are released here so they cannot stall writers.
+// ---------------------------------------------------------------------
+static u64 _quicksand_min_cursor(quicksand_ringbuffer *rb)
+{
+	u64 index = atomic_load_explicit(&rb->index, memory_order_acquire);
+	u64 now = quicksand_now();
+	u64 min = index;
+	for(i64 i = 0; i < QUICKSAND_MAX_PEERS; i += 1) {
+		quicksand_peer *p = &rb->peers[i];
+		if(atomic_load_explicit(&p->state, memory_order_acquire) != 2
+		   || !(atomic_load_explicit(&p->role, memory_order_acquire) & QUICKSAND_ROLE_RELIABLE)
+		   || _quicksand_reap(p, now)) {
+			continue;
+		}
+		u64 cursor = atomic_load_explicit(&p->cursor, memory_order_acquire);
+		if((i64) (cursor - min) < 0) {
+			min = cursor;
+		}
+	}
+	atomic_store_explicit(&rb->min_cursor, min, memory_order_relaxed);
+	return min;
+}
+
+// ---------------------------------------------------------------------
+// internal - hybrid wait: spin with a cpu pause, then sched_yield, then
+// sleep (on a futex when a writer will wake us)
+// ---------------------------------------------------------------------
+typedef struct {
+	u64 start;	// tick the wait began
+	f64 spin_ns;	// end of the busy-spin phase
+	f64 yield_ns;	// end of the sched_yield phase
+	f64 limit_ns;	// wait deadline (negative for none)
+} _quicksand_backoff;
+
+// A phase much shorter than the usual message gap would not catch the
+// next message: only spend an eighth of its budget there.
+static inline f64 _quicksand_phase(f64 gap_ns, f64 budget_ns)
+{
+	if(gap_ns <= 0.0) {
+		return budget_ns; // nothing learned yet
+	}
+	return gap_ns <= budget_ns ? fmin(4.0 * gap_ns, budget_ns) : budget_ns / 8.0;
+}
+
+static inline void _quicksand_learn(quicksand_connection *c, f64 gap_ns)
+{
+	c->arrival_ns = c->arrival_ns > 0.0 ? c->arrival_ns + (gap_ns - c->arrival_ns) / 8.0
+					    : gap_ns;
+}
+
+static inline void _quicksand_backoff_init(quicksand_connection *c,
+					   _quicksand_backoff *b, u64 start,
+					   f64 limit_ns)
+{
+	b->start = start;
+	b->spin_ns = _quicksand_phase(c->arrival_ns, c->wait_spin_ns);
+	b->yield_ns = b->spin_ns + _quicksand_phase(c->arrival_ns, c->wait_yield_ns);
+	b->limit_ns = limit_ns;
+}
+
+static void _quicksand_pause(quicksand_connection *c, _quicksand_backoff *b,
+			       u64 now, volatile _Atomic(u64) *word, u64 seen)
+{
+	f64 waited = quicksand_ns(now, b->start);
+	if(waited < b->spin_ns) {
+		cpu_relax();
+		return;
+	}
+	if(waited < b->yield_ns) {
+		sched_yield();
+		return;
+	}
+	f64 sleep_ns = c->wait_sleep_ns;
+	if(!word) {
+		sleep_ns = fmin(sleep_ns, waited); // nobody wakes us: back off gradually
+	}
+	if(b->limit_ns >= 0.0) {
+		sleep_ns = fmin(sleep_ns, b->limit_ns - waited);
+	}
+	if(sleep_ns <= 0.0) {
+		return;
+	}
+	u64 sleep = (u64) sleep_ns;
+	struct timespec timeout = {
+			.tv_sec = (time_t) (sleep / (u64) 1e9),
+			.tv_nsec = (long) (sleep % (u64) 1e9)};
+#ifdef __linux__
+	if(word) {
+		// futex compares the low half of the 64-bit word
+		u32 *low = (u32 *) word;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		low += 1;
+#endif
+		quicksand_ringbuffer *rb = c->buffer;
+		atomic_fetch_add_explicit(&rb->waiters, 1, memory_order_seq_cst);
+		syscall(SYS_futex, low, FUTEX_WAIT, (u32) seen, &timeout, NULL, 0);
+		atomic_fetch_sub_explicit(&rb->waiters, 1, memory_order_relaxed);
+		return;
+	}
+#endif
+	nanosleep(&timeout, NULL);
+}
+
+// Wake processes sleeping on rb->index after it moved
+static inline void _quicksand_wake(quicksand_ringbuffer *rb)
+{
+	atomic_thread_fence(memory_order_seq_cst); // index store before waiters load
+	if(atomic_load_explicit(&rb->waiters, memory_order_relaxed)) {
+#ifdef __linux__
+		u32 *low = (u32 *) &rb->index;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		low += 1;
+#endif
+		syscall(SYS_futex, low, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+#endif
+	}
+}
+
+// ---------------------------------------------------------------------
+// internal - skip the head slot if the writer that reserved it died.
+// Writers stamp the owner word right after reserving, so a peer stuck
+// behind a dead writer can complete the slot as abandoned in
+// microseconds instead of waiting for the ring lock timeout.
+// ---------------------------------------------------------------------
+static i64 _quicksand_recover(quicksand_ringbuffer *rb, u64 head)
+{
+	u64 data_offset = round_to_64((i64) sizeof(quicksand_ringbuffer));
+	u8 *slot_ptr = (u8 *) rb + data_offset
+			+ (head & (rb->length - 1)) * (u64) rb->message_size;
+	_Atomic(u64) *owner_ptr = (_Atomic(u64) *) (slot_ptr + 16);
+	u64 owner = atomic_load_explicit(owner_ptr, memory_order_acquire);
+	if((owner >> 32) != (head & 0xffffffff) || !(owner & 0xffffffff)) {
+		return 0; // owner has not stamped the slot yet (or it is being recovered)
+	}
+	if(kill((pid_t) (owner & 0xffffffff), 0) == 0 || errno != ESRCH) {
+		return 0; // owner is alive (just slow)
+	}
+
+	// Claim the slot before touching it: only one recoverer may write its
+	// length, and only while the ring still waits on it
+	if(!atomic_compare_exchange_strong_explicit(owner_ptr, &owner, owner & ~0xffffffffull,
+						    memory_order_acq_rel, memory_order_relaxed)) {
+		return 0; // another peer recovers it
+	}
+	if(atomic_load_explicit(&rb->index, memory_order_acquire) != head) {
+		return 0; // published before its writer died
+	}
+	*((volatile i64 *) (slot_ptr + 8)) = QUICKSAND_SLOT_ABANDONED;
+	atomic_store_explicit(&rb->updatestamp, quicksand_now(), memory_order_relaxed);
+	atomic_compare_exchange_strong_explicit(&rb->index, &head, head + 1,
+						memory_order_release, memory_order_relaxed);
+	_quicksand_wake(rb);
+	return 1;
+}
+
+// ---------------------------------------------------------------------
+// internal - called while spinning on rb->index.  Checks the owner of
+// the head slot once it has not moved for QUICKSAND_RECOVER.
+// ---------------------------------------------------------------------
+static inline void _quicksand_stalled(quicksand_ringbuffer *rb, u64 head,
+				      u64 now, u64 *last_head, u64 *since)
+{
+	if(head != *last_head) {
+		*last_head = head;
+		*since = now;
+	} else if(quicksand_ns(now, *since) > QUICKSAND_RECOVER) {
+		_quicksand_recover(rb, head);
+		*since = now;
+	}
+}
+
+// A slot between reservation and publication
+typedef struct {
+	u64 reserve;		   // Ring index of the slot
+	u64 start;		   // Timestamp the wait budget counts from
+	u64 last_head;		   // Stall tracking for _quicksand_stalled
+	u64 since;		   //
+	u8 *slot;		   // Slot address (header first)
+	_quicksand_backoff backoff; //
+} _quicksand_slot;
+
+// ---------------------------------------------------------------------
+// internal - reserve a slot for msg_len bytes using a policy.  The
+// owner is stamped, so the slot only has to be filled and committed.
+// ---------------------------------------------------------------------
+static i64 _quicksand_commit(quicksand_connection *c, _quicksand_slot *s, i64 msg_len);
+
+static i64 _quicksand_reserve(quicksand_connection *c, i64 msg_len, i64 policy,
+			      _quicksand_slot *s)
+{
+	u64 start_time = quicksand_now();
 	quicksand_ringbuffer *rb = c->buffer;
-	if(!rb || rb->length <= 0) {
-		return -EPIPE; // uninitialised
+
+	// follow a grown topic
+	if(atomic_load_explicit(&rb->successor, memory_order_relaxed)) {
+		i64 ret = _quicksand_follow(c);
+		if(ret) {
+			return ret;
+		}
+		rb = c->buffer;
 	}
 
 	// attempt unlock
@@ -408,60 +1696,444 @@ i64 quicksand_write(quicksand_connection *c, u8 *msg, i64 msg_len)
 	}
 
 
-	if(msg_len < 0 || msg_len > ((i64) rb->message_size) - 16) {
+	if(c->grow && msg_len > c->max_payload) {
+		i64 ret = quicksand_grow(c, msg_len, -1);
+		if(ret) {
+			return ret;
+		}
+		rb = c->buffer;
+	}
+	if(msg_len < 0 || msg_len > c->max_payload) {
 		return -EMSGSIZE; // message does not fit
 	}
 
 	// -----------------------------------------------------------------
-	// 1. Reserve a slot (atomic fetch‑add)
+	// 1. Reserve a slot (atomic fetch‑add) that does not lap the slowest
+	//    registered reader.  The cached minimum is only rescanned when
+	//    it looks lapped, so writers do not walk the reader table.
 	// -----------------------------------------------------------------
+	_quicksand_backoff_init(c, &s->backoff, start_time, QUICKSAND_TIMEOUT / 2);
 	u64 my_reserve = atomic_load_explicit(&rb->reserve, memory_order_relaxed);
-	while(!atomic_compare_exchange_weak_explicit(&rb->reserve, &my_reserve,
-						     my_reserve + 1, memory_order_relaxed, memory_order_relaxed)) {
+	for(;;) {
+		if(policy != QUICKSAND_LOSSY
+		   && my_reserve - atomic_load_explicit(&rb->min_cursor, memory_order_acquire)
+				      > c->mask
+		   && my_reserve - _quicksand_min_cursor(rb) > c->mask) {
+			if(policy != QUICKSAND_BLOCK) {
+				return -EAGAIN; // reader would be lapped
+			}
+			u64 now = quicksand_now();
+			if(quicksand_ns(now, start_time) > QUICKSAND_TIMEOUT / 2) {
+				return -ETIMEDOUT;
+			}
+			_quicksand_pause(c, &s->backoff, now, NULL, 0); // readers do not wake us
+			my_reserve = atomic_load_explicit(&rb->reserve, memory_order_relaxed);
+			continue;
+		}
+		if(atomic_compare_exchange_weak_explicit(&rb->reserve, &my_reserve,
+							 my_reserve + 1, memory_order_seq_cst, memory_order_relaxed)) {
+			break;
+		}
 		if(quicksand_ns(quicksand_now(), start_time) > QUICKSAND_TIMEOUT / 2) {
 			return -ETIMEDOUT;
 		}
 	}
 
+	// A reservation made after the ring was retired may be behind readers
+	// that already moved on: publish it as abandoned and retry.
+	u64 retired = atomic_load_explicit(&rb->successor, memory_order_seq_cst);
+
 	// -----------------------------------------------------------------
 	// 2. Block until reserve < 50% away from index
 	// -----------------------------------------------------------------
-	while(my_reserve - atomic_load_explicit(&rb->index, memory_order_relaxed)
-	      > rb->length / 2) {
-		if(quicksand_ns(quicksand_now(), start_time) > QUICKSAND_TIMEOUT / 2) {
+	u64 head, last_head = my_reserve, since = start_time;
+	while(my_reserve - (head = atomic_load_explicit(&rb->index, memory_order_relaxed))
+	      > (c->mask + 1) / 2) {
+		u64 now = quicksand_now();
+		_quicksand_stalled(rb, head, now, &last_head, &since);
+		if(quicksand_ns(now, start_time) > QUICKSAND_TIMEOUT / 2) {
 			atomic_store_explicit(&rb->locked, quicksand_now(), memory_order_relaxed);
 			return -ETIMEDOUT;
 		}
+		_quicksand_pause(c, &s->backoff, now, &rb->index, head);
 	}
 
 	// -----------------------------------------------------------------
-	// 3. Write the message
+	// 3. Claim the slot, owner first so peers can recover it
 	// -----------------------------------------------------------------
-	u64 slot = my_reserve & (rb->length - 1);
-	u8 *base = (u8 *) rb;
-	u64 data_offset = round_to_64((i64) sizeof(quicksand_ringbuffer));
-	u8 *slot_ptr = base + data_offset + slot * (u64) rb->message_size;
+	s->reserve = my_reserve;
+	s->start = start_time;
+	s->last_head = last_head;
+	s->since = since;
+	s->slot = c->data + (my_reserve & c->mask) * c->stride;
+	*((volatile u64 *) (s->slot + 16)) = (my_reserve << 32) | c->pid;
+
+	if(retired) {
+		i64 ret = _quicksand_commit(c, s, QUICKSAND_SLOT_ABANDONED);
+		return ret ? ret : _quicksand_reserve(c, msg_len, policy, s);
+	}
+	return 0;
+}
 
-	*((u64 *) slot_ptr) = quicksand_now();
-	*((i64 *) (slot_ptr + 8)) = msg_len;
-	fast_memcpy(slot_ptr + 16, msg, msg_len);
+// ---------------------------------------------------------------------
+// internal - make a published slot durable (file-backed topics)
+// ---------------------------------------------------------------------
+static void _quicksand_persist(quicksand_connection *c, u8 *slot)
+{
+	if(c->sync == QUICKSAND_SYNC_FDATASYNC) {
+		fdatasync((int) c->shared_memory_handle);
+		return;
+	}
+	static uintptr_t page = 0;
+	if(!page) {
+		page = (uintptr_t) sysconf(_SC_PAGESIZE);
+	}
+	// The slot, then the page holding the index that publishes it
+	uintptr_t from = (uintptr_t) slot & ~(page - 1);
+	msync((void *) from, (uintptr_t) slot + c->stride - from, MS_SYNC);
+	msync((void *) c->buffer, page, MS_SYNC);
+}
+
+// ---------------------------------------------------------------------
+// internal - publish a reserved slot once every earlier one is published
+// ---------------------------------------------------------------------
+static i64 _quicksand_commit(quicksand_connection *c, _quicksand_slot *s, i64 msg_len)
+{
+	quicksand_ringbuffer *rb = c->buffer;
+	// Zero the padding to 8 bytes: bridges send it straight from the slot
+	if(msg_len > 0) {
+		memset(s->slot + QUICKSAND_SLOT_HEADER + msg_len, 0, (u64) -msg_len & 7);
+	}
+	*((u64 *) s->slot) = quicksand_now();
+	*((i64 *) (s->slot + 8)) = msg_len;
 
 	// -----------------------------------------------------------------
 	// 4. Wait to advance index
 	// -----------------------------------------------------------------
-	while(my_reserve != atomic_load_explicit(&rb->index, memory_order_relaxed)) {
-		if(quicksand_ns(quicksand_now(), start_time) > QUICKSAND_TIMEOUT / 2) {
-			atomic_store_explicit(&rb->locked, start_time, memory_order_release);
+	u64 head;
+	while(s->reserve != (head = atomic_load_explicit(&rb->index, memory_order_relaxed))) {
+		u64 now = quicksand_now();
+		_quicksand_stalled(rb, head, now, &s->last_head, &s->since);
+		if(quicksand_ns(now, s->start) > QUICKSAND_TIMEOUT / 2) {
+			atomic_store_explicit(&rb->locked, s->start, memory_order_release);
 			return -ETIMEDOUT;
 		}
+		_quicksand_pause(c, &s->backoff, now, &rb->index, head);
 	}
 
-	atomic_store_explicit(&rb->updatestamp, quicksand_now(), memory_order_relaxed);
-	atomic_store_explicit(&rb->index, my_reserve + 1, memory_order_release);
+	u64 now = quicksand_now();
+	atomic_store_explicit(&rb->updatestamp, now, memory_order_relaxed);
+	atomic_store_explicit(&rb->index, s->reserve + 1, memory_order_release);
+	_quicksand_wake(rb);
+	if(c->sync) {
+		_quicksand_persist(c, s->slot);
+	}
+	if(s->last_head != s->reserve || s->since != s->start) {
+		_quicksand_learn(c, quicksand_ns(now, s->start)); // we had to wait
+	}
+	_quicksand_touch(c, QUICKSAND_ROLE_WRITER, now);
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - put a new payload into the ring buffer using a policy
+// ---------------------------------------------------------------------
+static i64 _quicksand_publish(quicksand_connection *c, u8 *msg, i64 msg_len,
+			      i64 policy)
+{
+	_quicksand_slot s;
+	i64 ret = _quicksand_reserve(c, msg_len, policy, &s);
+	if(ret) {
+		return ret;
+	}
+	fast_memcpy(s.slot + QUICKSAND_SLOT_HEADER, msg, msg_len);
+	return _quicksand_commit(c, &s, msg_len);
+}
+
+// ---------------------------------------------------------------------
+// internal - queue a message in the writer's side buffer.
+// Records are [i64 length][payload] padded to 8 bytes.
+// ---------------------------------------------------------------------
+static i64 _quicksand_spill(quicksand_connection *c, u8 *msg, i64 msg_len)
+{
+	if(msg_len < 0 || msg_len > c->max_payload) {
+		return -EMSGSIZE;
+	}
+	u64 record = 8 + (((u64) msg_len + 7) & ~(u64) 7);
+	if(c->spill_tail + record > c->spill_size) {
+		return -ENOBUFS; // side buffer full, message dropped
+	}
+	u8 *dest = c->spill + c->spill_tail;
+	*((i64 *) dest) = msg_len;
+	fast_memcpy(dest + 8, msg, msg_len);
+	c->spill_tail += record;
+	return 0;
+}
+
+i64 quicksand_flush(quicksand_connection *c)
+{
+	if(!c || !c->buffer) {
+		return -EINVAL;
+	}
+	while(c->spill_head != c->spill_tail) {
+		u8 *src = c->spill + c->spill_head;
+		i64 len = *((i64 *) src);
+		i64 ret = _quicksand_publish(c, src + 8, len, QUICKSAND_FAIL);
+		if(ret == -EAGAIN || ret == -ETIMEDOUT) {
+			return -EAGAIN;
+		}
+		// other errors drop the message so the queue cannot wedge
+		c->spill_head += 8 + (((u64) len + 7) & ~(u64) 7);
+	}
+	c->spill_head = 0;
+	c->spill_tail = 0;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_write – put a new payload into the ring buffer
+// ---------------------------------------------------------------------
+i64 quicksand_write(quicksand_connection *c, u8 *msg, i64 msg_len)
+{
+	if(!c || !msg || c->claim) {
+		return -EINVAL; // (would wait behind our own reserved slot)
+	}
+	if(!c->buffer || !c->stride) {
+		_quicksand_geometry(c); // attached before the creator initialized it
+		if(!c->buffer || !c->stride) {
+			return -EPIPE; // uninitialised
+		}
+	}
+	if(c->backpressure != QUICKSAND_SPILL) {
+		return _quicksand_publish(c, msg, msg_len, c->backpressure);
+	}
+
+	// Keep message order: new messages queue behind spilled ones
+	if(c->spill_head != c->spill_tail && quicksand_flush(c) != 0) {
+		return _quicksand_spill(c, msg, msg_len);
+	}
+	i64 ret = _quicksand_publish(c, msg, msg_len, QUICKSAND_FAIL);
+	if(ret == -EAGAIN) {
+		return _quicksand_spill(c, msg, msg_len);
+	}
+	return ret;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_reserve – hand out the next slot to be filled in place
+// ---------------------------------------------------------------------
+i64 quicksand_reserve(quicksand_connection *c, u8 **msg, i64 msg_len)
+{
+	if(!c || !msg || c->claim) {
+		return -EINVAL;
+	}
+	if(!c->buffer || !c->stride) {
+		_quicksand_geometry(c);
+		if(!c->buffer || !c->stride) {
+			return -EPIPE;
+		}
+	}
+	// Spilled messages go first, and a slot cannot be spilled
+	i64 policy = c->backpressure;
+	if(policy == QUICKSAND_SPILL) {
+		if(c->spill_head != c->spill_tail && quicksand_flush(c) != 0) {
+			return -EAGAIN;
+		}
+		policy = QUICKSAND_FAIL;
+	}
+	_quicksand_slot s;
+	i64 ret = _quicksand_reserve(c, msg_len, policy, &s);
+	if(ret) {
+		return ret;
+	}
+	c->claim = s.slot;
+	c->claim_index = s.reserve;
+	c->claim_size = msg_len;
+	*msg = s.slot + QUICKSAND_SLOT_HEADER;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_commit – publish the slot handed out by quicksand_reserve
+// ---------------------------------------------------------------------
+i64 quicksand_commit(quicksand_connection *c, i64 msg_len)
+{
+	if(!c || !c->claim) {
+		return -EINVAL;
+	}
+	if(msg_len < 0 || msg_len > c->claim_size) {
+		msg_len = QUICKSAND_SLOT_ABANDONED; // cancel: readers skip the slot
+	}
+	_quicksand_slot s = {.reserve = c->claim_index, .slot = c->claim};
+	s.start = quicksand_now();
+	s.last_head = s.reserve;
+	s.since = s.start;
+	_quicksand_backoff_init(c, &s.backoff, s.start, QUICKSAND_TIMEOUT / 2);
+	c->claim = NULL;
+	i64 ret = _quicksand_commit(c, &s, msg_len);
+	if(ret == 0 && msg_len == QUICKSAND_SLOT_ABANDONED) {
+		return -ECANCELED;
+	}
+	return ret;
+}
+
+// ---------------------------------------------------------------------
+// Latency histogram: values below 2^(SUB_BITS+1) have their own bucket,
+// larger ones are bucketed by [exponent][top SUB_BITS+1 bits]
+// ---------------------------------------------------------------------
+#define HISTOGRAM_SUB_COUNT (1ull << QUICKSAND_HISTOGRAM_SUB_BITS)
+
+static inline u64 _quicksand_bucket(u64 value)
+{
+	if(value < 2 * HISTOGRAM_SUB_COUNT) {
+		return value;
+	}
+	u64 shift = (u64) (63 - __builtin_clzll(value)) - QUICKSAND_HISTOGRAM_SUB_BITS;
+	return shift * HISTOGRAM_SUB_COUNT + (value >> shift);
+}
+
+// Highest value that lands in a bucket
+static inline u64 _quicksand_bucket_max(u64 bucket)
+{
+	if(bucket < 2 * HISTOGRAM_SUB_COUNT) {
+		return bucket;
+	}
+	u64 shift = bucket / HISTOGRAM_SUB_COUNT - 1;
+	u64 sub = bucket % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT;
+	return ((sub + 1) << shift) - 1;
+}
+
+static inline void _quicksand_record(quicksand_histogram *h, u64 ticks)
+{
+	h->counts[_quicksand_bucket(ticks)] += 1;
+	h->min = ticks < h->min ? ticks : h->min;
+	h->max = ticks > h->max ? ticks : h->max;
+	h->count += 1;
+}
+
+void quicksand_histogram_record(quicksand_histogram *h, u64 ticks)
+{
+	_quicksand_record(h, ticks);
+}
+
+void quicksand_histogram_reset(quicksand_histogram *h)
+{
+	memset(h->counts, 0, sizeof(h->counts));
+	h->count = 0;
+	h->min = UINT64_MAX;
+	h->max = 0;
+}
+
+f64 quicksand_histogram_percentile(quicksand_histogram *h, f64 percentile)
+{
+	if(!h->count) {
+		return 0.0;
+	}
+	percentile = percentile < 0.0 ? 0.0 : (percentile > 100.0 ? 100.0 : percentile);
+	u64 target = (u64) (percentile * 0.01 * (f64) h->count + 0.5);
+	target = target ? target : 1;
+	u64 seen = 0;
+	for(u64 i = 0; i < QUICKSAND_HISTOGRAM_BUCKETS; i += 1) {
+		seen += h->counts[i];
+		if(seen >= target) {
+			u64 value = _quicksand_bucket_max(i);
+			value = value < h->max ? value : h->max;
+			return (f64) quicksand_ticks_ns(value);
+		}
+	}
+	return (f64) quicksand_ticks_ns(h->max);
+}
 
+i64 quicksand_latency(quicksand_connection *c, quicksand_histogram *h)
+{
+	if(!c) {
+		return -EINVAL;
+	}
+	if(h) {
+		quicksand_histogram_reset(h);
+	}
+	c->latency = h;
 	return 0;
 }
 
+// ---------------------------------------------------------------------
+// internal - a published slot for readers that do not copy it out
+// (the bridge sends straight from the ring, the recorder batches)
+// ---------------------------------------------------------------------
+i64 _quicksand_peek(quicksand_connection *c, u64 index, u8 **payload, u64 *stamp)
+{
+	u8 *slot_ptr = c->data + (index & c->mask) * c->stride;
+	*stamp = *((u64 *) slot_ptr);
+	i64 payload_len = *((i64 *) (slot_ptr + 8));
+	if(payload_len == QUICKSAND_SLOT_ABANDONED) {
+		return QUICKSAND_SLOT_ABANDONED;
+	}
+	if(payload_len < 0 || payload_len > c->max_payload) {
+		return -EBADMSG;
+	}
+	*payload = slot_ptr + QUICKSAND_SLOT_HEADER;
+	return payload_len;
+}
+
+// ---------------------------------------------------------------------
+// internal - the messages a batching reader may take next: from
+// c->read_index (moved past what an unregistered reader can no longer
+// read, like quicksand_read) up to end.  Follows a grown topic once
+// caught up.  Returns the number pending or -x for error.
+// ---------------------------------------------------------------------
+i64 _quicksand_pending(quicksand_connection *c, u64 *end)
+{
+	quicksand_ringbuffer *rb = c->buffer;
+	if(!c->stride) {
+		_quicksand_geometry(c);
+		if(!c->stride) {
+			return -EPIPE; // not initialized
+		}
+	}
+	u64 write_cursor = atomic_load_explicit(&rb->index, memory_order_acquire);
+	*end = write_cursor;
+	if(c->read_index == write_cursor) {
+		if(atomic_load_explicit(&rb->successor, memory_order_seq_cst)
+		   && atomic_load_explicit(&rb->reserve, memory_order_seq_cst) == write_cursor
+		   && _quicksand_remap(c) == 0) {
+			return _quicksand_pending(c, end);
+		}
+		return 0;
+	}
+
+	u64 now = quicksand_now();
+	quicksand_peer *peer = c->peer_slot >= 0 ? &rb->peers[c->peer_slot] : NULL;
+	u64 distance = write_cursor - c->read_index;
+	if(peer && c->read_index != 0
+	   && distance > atomic_load_explicit(&peer->lag, memory_order_relaxed)) {
+		atomic_store_explicit(&peer->lag, distance, memory_order_relaxed);
+	}
+	u64 reliable = peer
+			&& (atomic_load_explicit(&peer->role, memory_order_relaxed)
+			    & QUICKSAND_ROLE_RELIABLE);
+	u8 *slot_ptr = c->data + (c->read_index & c->mask) * c->stride;
+	if(!reliable
+	   && (distance > (c->mask + 1) / 2
+	       || quicksand_ns(now, *((volatile u64 *) slot_ptr)) > QUICKSAND_TIMEOUT)) {
+		c->read_index = write_cursor - 1; // skip stale data
+	}
+	c->read_stamp = now;
+	return (i64) (write_cursor - c->read_index);
+}
+
+// ---------------------------------------------------------------------
+// internal - a batching reader is done with every slot before index
+// ---------------------------------------------------------------------
+void _quicksand_consume(quicksand_connection *c, u64 index)
+{
+	c->read_index = index;
+	if(c->peer_slot >= 0) {
+		quicksand_peer *peer = &c->buffer->peers[c->peer_slot];
+		atomic_store_explicit(&peer->tick, c->read_stamp, memory_order_relaxed);
+		atomic_store_explicit(&peer->cursor, index, memory_order_release);
+	}
+}
+
 // ---------------------------------------------------------------------
 // quicksand_read – fetch the next available payload, if any
 // ---------------------------------------------------------------------
@@ -471,9 +2143,11 @@ i64 quicksand_read(quicksand_connection *c, u8 *msg, i64 *msg_len)
 		return -EINVAL;
 	}
 	quicksand_ringbuffer *rb = c->buffer;
-
-	if(rb->length <= 0) {
-		return -EPIPE; // not initialized
+	if(!c->stride) {
+		_quicksand_geometry(c); // attached before the creator initialized it
+		if(!c->stride) {
+			return -EPIPE; // not initialized
+		}
 	}
 
 	// -----------------------------------------------------------------
@@ -491,11 +2165,16 @@ i64 quicksand_read(quicksand_connection *c, u8 *msg, i64 *msg_len)
 	// if(write_cursor - c->read_index > (u64) 1e18) {  // Should not happen, reader>writer
 	// 	c->read_index = write_cursor;
 	// }
-	u64 now = quicksand_now();
 	if(c->read_index == write_cursor) {
+		// Follow a grown topic once every reservation in the old ring
+		// has been published and read.
+		if(atomic_load_explicit(&rb->successor, memory_order_seq_cst)
+		   && atomic_load_explicit(&rb->reserve, memory_order_seq_cst) == write_cursor
+		   && _quicksand_remap(c) == 0) {
+			return quicksand_read(c, msg, msg_len);
+		}
 		// printf("read index at limit\n");
 		// No new message – consumer is caught up
-		c->read_stamp = now;
 		return -1; // “0 messages read”
 	}
 
@@ -503,20 +2182,31 @@ i64 quicksand_read(quicksand_connection *c, u8 *msg, i64 *msg_len)
 	// 3. The writer may have advanced *many* slots ahead.  If the distance
 	//    is larger than half the ring we clamp the “oldest readable” slot
 	//    to (write_cursor‑1).
+	//    Registered readers never skip: writers wait for them instead.
 	// -----------------------------------------------------------------
+	u64 now = quicksand_now();
+	quicksand_peer *peer = c->peer_slot >= 0 ? &rb->peers[c->peer_slot] : NULL;
 	u64 distance = write_cursor - c->read_index;
-	f64 time_delta = quicksand_ns(rb->updatestamp, c->read_stamp);
-	if(distance > (rb->length / 2) || (time_delta > QUICKSAND_TIMEOUT && write_cursor > c->read_index)) {
-		c->read_index = write_cursor - 1; // skip stale data
+	// (the backlog seen by a reader's first read is not lag)
+	if(peer && c->read_index != 0
+	   && distance > atomic_load_explicit(&peer->lag, memory_order_relaxed)) {
+		atomic_store_explicit(&peer->lag, distance, memory_order_relaxed);
 	}
+	u64 reliable = peer
+			&& (atomic_load_explicit(&peer->role, memory_order_relaxed)
+			    & QUICKSAND_ROLE_RELIABLE);
 
 	// -----------------------------------------------------------------
-	// 4. Compute slot location and update read index
+	// 4. Compute slot location (skipping to the newest slot when the
+	//    next one is lapped or older than the timeout)
 	// -----------------------------------------------------------------
-	u64 slot = c->read_index & (rb->length - 1);
-	u8 *base = (u8 *) rb;
-	u64 data_offset = round_to_64((i64) sizeof(quicksand_ringbuffer));
-	u8 *slot_ptr = base + data_offset + slot * (u64) rb->message_size;
+	u8 *slot_ptr = c->data + (c->read_index & c->mask) * c->stride;
+	if(!reliable
+	   && (distance > (c->mask + 1) / 2
+	       || quicksand_ns(now, *((volatile u64 *) slot_ptr)) > QUICKSAND_TIMEOUT)) {
+		c->read_index = write_cursor - 1; // skip stale data
+		slot_ptr = c->data + (c->read_index & c->mask) * c->stride;
+	}
 
 	// -----------------------------------------------------------------
 	// 5. Advance our local read pointer so the next call reads the next slot.
@@ -527,11 +2217,19 @@ i64 quicksand_read(quicksand_connection *c, u8 *msg, i64 *msg_len)
 	// -----------------------------------------------------------------
 	// 6. Read the timestamp and size that the writer stored at front
 	// -----------------------------------------------------------------
-	// u64 payload_stamp = *((u64 *) slot_ptr); // unused
-	i64 payload_len = *((i64 *) (slot_ptr + 8));
-	if(payload_len < 0 || payload_len > ((i64) rb->message_size) - 16) {
+	u64 payload_stamp = 0;
+	u8 *payload = NULL;
+	i64 payload_len = _quicksand_peek(c, c->read_index - 1, &payload, &payload_stamp);
+	if(payload_len == QUICKSAND_SLOT_ABANDONED) {
+		// The writer died mid-publish and a peer skipped its slot
+		if(peer) {
+			atomic_store_explicit(&peer->cursor, c->read_index, memory_order_release);
+		}
+		return quicksand_read(c, msg, msg_len);
+	}
+	if(payload_len < 0) {
 		// Corrupted size – treat as no‑data
-		return -EBADMSG;
+		return payload_len;
 	}
 
 	// -----------------------------------------------------------------
@@ -541,9 +2239,67 @@ i64 quicksand_read(quicksand_connection *c, u8 *msg, i64 *msg_len)
 		return -EINVAL; // too short
 	}
 
-	fast_memcpy(msg, slot_ptr + 16, payload_len);
+	fast_memcpy(msg, payload, payload_len);
 	*msg_len = payload_len; // tell the caller how many bytes we wrote
 
+	// Learn the message gap that quicksand_wait adapts to
+	if(c->arrival_stamp && (i64) (payload_stamp - c->arrival_stamp) > 0) {
+		_quicksand_learn(c, quicksand_ns(payload_stamp, c->arrival_stamp));
+	}
+	c->arrival_stamp = payload_stamp;
+	if(c->latency) {
+		u64 latency = now - payload_stamp; // (stamp may be a few ticks ahead)
+		_quicksand_record(c->latency, (i64) latency > 0 ? latency : 0);
+	}
+
+	// Publish our cursor once the slot is free to be overwritten
+	if(peer) {
+		atomic_store_explicit(&peer->tick, now, memory_order_relaxed);
+		atomic_store_explicit(&peer->cursor, c->read_index, memory_order_release);
+	}
+
 	// Return the number of messages still pending after we consumed one.
 	return (i64) (write_cursor - c->read_index);
 }
+
+// ---------------------------------------------------------------------
+// quicksand_wait_policy – configure spin/yield/sleep budgets
+// ---------------------------------------------------------------------
+i64 quicksand_wait_policy(quicksand_connection *c, f64 spin_ns, f64 yield_ns,
+			  f64 sleep_ns)
+{
+	if(!c || spin_ns < 0.0 || yield_ns < 0.0 || sleep_ns < 0.0
+	   || sleep_ns >= QUICKSAND_TIMEOUT) {
+		return -EINVAL;
+	}
+	c->wait_spin_ns = spin_ns > 0.0 ? spin_ns : c->wait_spin_ns;
+	c->wait_yield_ns = yield_ns > 0.0 ? yield_ns : c->wait_yield_ns;
+	c->wait_sleep_ns = sleep_ns > 0.0 ? sleep_ns : c->wait_sleep_ns;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_wait – block until there is something to read
+// ---------------------------------------------------------------------
+i64 quicksand_wait(quicksand_connection *c, f64 timeout_ns)
+{
+	if(!c || !c->buffer) {
+		return -EINVAL;
+	}
+	u64 start = quicksand_now();
+	_quicksand_backoff backoff;
+	_quicksand_backoff_init(c, &backoff, start, timeout_ns);
+	for(;;) {
+		quicksand_ringbuffer *rb = c->buffer;
+		u64 head = atomic_load_explicit(&rb->index, memory_order_acquire);
+		if(head != c->read_index
+		   || atomic_load_explicit(&rb->successor, memory_order_relaxed)) {
+			return 0; // (quicksand_read follows a grown topic)
+		}
+		u64 now = quicksand_now();
+		if(timeout_ns >= 0.0 && quicksand_ns(now, start) >= timeout_ns) {
+			return -ETIMEDOUT;
+		}
+		_quicksand_pause(c, &backoff, now, &rb->index, head);
+	}
+}
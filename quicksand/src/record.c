@@ -0,0 +1,267 @@
+// -------------------------------------------------------------------------
+// record.c – drain topics into size-rotated log files
+// -------------------------------------------------------------------------
+//
+// Each log file is a QUICKSAND_LOG_HEADER byte header followed by records:
+//   [quicksand_log_record][payload padded to 8 bytes]...
+//
+// Messages are copied straight from the ring slots into a page-aligned
+// buffer (after their record header), a ring's worth per topic before the
+// slots are handed back.  They only leave it in whole multiples of the
+// page size, so the kernel sees a few large aligned writes rather than one
+// small write per message.  Only the tail of a file (flush, close, rotation)
+// is written unaligned.
+// -------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "quicksand.h"
+#include "quicksand_internal.h"
+#include "quicksand_style.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RECORD_PAGE 4096
+#define RECORD_BUFFER (1 << 20) // write buffer bytes (grown for huge topics)
+
+// ---------------------------------------------------------------------
+// internal - write len bytes, retrying short writes
+// ---------------------------------------------------------------------
+static i64 write_all(i64 fd, u8 *data, u64 len)
+{
+	while(len) {
+		ssize_t n = write((int) fd, data, len);
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		data += n;
+		len -= (u64) n;
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - write out the buffer (only whole pages unless all is set)
+// ---------------------------------------------------------------------
+static i64 drain(quicksand_recorder *r, u8 all)
+{
+	u64 len = all ? r->used : r->used & ~(u64) (RECORD_PAGE - 1);
+	if(!len) {
+		return 0;
+	}
+	i64 ret = write_all(r->fd, r->buffer, len);
+	if(ret < 0) {
+		return ret;
+	}
+	memmove(r->buffer, r->buffer + len, r->used - len);
+	r->used -= len;
+	r->file_bytes += len;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// internal - close the current file and start the next one
+// ---------------------------------------------------------------------
+static i64 rotate(quicksand_recorder *r)
+{
+	if(r->fd >= 0) {
+		i64 ret = drain(r, 1);
+		if(ret < 0) {
+			return ret;
+		}
+		close((int) r->fd);
+		r->fd = -1;
+		r->header.segment += 1;
+	}
+	char path[sizeof(r->prefix) + 32];
+	snprintf(path, sizeof(path), "%s.%06lu.qslog", r->prefix,
+		 (unsigned long) r->header.segment);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		return -errno;
+	}
+	r->fd = fd;
+	for(i64 i = 0; i < r->count; i += 1) {
+		quicksand_clock *clock = &r->header.topic[i].clock;
+		clock->sequence = _quicksand_clock_read(&r->topics[i]->buffer->clock, clock);
+	}
+	r->file_bytes = 0;
+
+	// The header is a whole number of pages, so later writes stay page aligned
+	memcpy(r->buffer, &r->header, QUICKSAND_LOG_HEADER);
+	r->used = QUICKSAND_LOG_HEADER;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_record_open – connect to the topics and open the first file
+// ---------------------------------------------------------------------
+i64 quicksand_record_open(quicksand_recorder **recorder, char *prefix,
+			  char **topics, i64 count, i64 max_file_bytes, i64 reliable)
+{
+	if(!recorder || !prefix || !topics || count < 1 || count > QUICKSAND_LOG_TOPICS
+	   || max_file_bytes < 0 || strlen(prefix) >= sizeof((*recorder)->prefix)) {
+		return -EINVAL;
+	}
+	quicksand_recorder *r = calloc(1, sizeof(quicksand_recorder));
+	if(!r) {
+		return -ENOMEM;
+	}
+	r->fd = -1;
+	r->max_file_bytes = (u64) max_file_bytes;
+	strcpy(r->prefix, prefix);
+	r->header.magic = QUICKSAND_LOG_MAGIC;
+	r->header.version = QUICKSAND_LOG_VERSION;
+
+	i64 ret = 0;
+	u64 largest = 0;
+	for(i64 i = 0; i < count && ret == 0; i += 1) {
+		if(!topics[i] || strlen(topics[i]) >= sizeof(r->header.topic[i].name)) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = quicksand_connect(&r->topics[i], topics[i], -1, -1, -1, NULL);
+		if(ret != 0) {
+			break;
+		}
+		r->count = i + 1;
+		quicksand_connection *c = r->topics[i];
+		c->read_index = atomic_load_explicit(&c->buffer->index, memory_order_acquire);
+		if(reliable) {
+			ret = quicksand_register(c);
+		}
+		strcpy(r->header.topic[i].name, topics[i]);
+		r->header.topic[i].message_size = (u64) c->max_payload;
+		largest = (u64) c->max_payload > largest ? (u64) c->max_payload : largest;
+	}
+	r->header.topics = (u64) r->count;
+
+	// Room for the header plus a few of the largest records
+	r->buffer_size = RECORD_BUFFER;
+	while(r->buffer_size < QUICKSAND_LOG_HEADER + 4 * (largest + sizeof(quicksand_log_record) + 8)) {
+		r->buffer_size *= 2;
+	}
+	if(ret == 0 && posix_memalign((void **) &r->buffer, RECORD_PAGE, r->buffer_size) != 0) {
+		ret = -ENOMEM;
+	}
+	if(ret == 0) {
+		ret = rotate(r);
+	}
+	if(ret != 0) {
+		quicksand_record_close(&r);
+		return ret;
+	}
+	*recorder = r;
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_record_poll – move every readable message into the log
+// ---------------------------------------------------------------------
+i64 quicksand_record_poll(quicksand_recorder *r)
+{
+	if(!r || r->fd < 0) {
+		return -EINVAL;
+	}
+	i64 records = 0;
+	for(i64 t = 0; t < r->count; t += 1) {
+		quicksand_connection *c = r->topics[t];
+		// One ring's worth per topic so a busy topic cannot starve the rest.
+		// The slots are copied once, straight into the write buffer, and
+		// stay ours until they are handed back after the batch.
+		u64 n = 0;
+		while(n <= c->mask) {
+			u64 end = 0;
+			i64 ret = _quicksand_pending(c, &end);
+			if(ret <= 0) {
+				if(ret < 0) {
+					return ret;
+				}
+				break; // caught up
+			}
+			u64 index = c->read_index;
+			for(; index != end && n <= c->mask; index += 1, n += 1) {
+				u8 *payload = NULL;
+				u64 stamp = 0;
+				i64 length = _quicksand_peek(c, index, &payload, &stamp);
+				if(length == QUICKSAND_SLOT_ABANDONED) {
+					continue; // (a dead writer's slot, skipped by readers)
+				}
+				if(length < 0) {
+					r->dropped += 1; // (torn or corrupted, as quicksand_read reports)
+					continue;
+				}
+				u64 size = sizeof(quicksand_log_record) + (((u64) length + 7) & ~(u64) 7);
+				if(r->max_file_bytes && r->file_bytes + r->used + size > r->max_file_bytes
+				   && r->file_bytes + r->used > QUICKSAND_LOG_HEADER) {
+					ret = rotate(r);
+					if(ret < 0) {
+						_quicksand_consume(c, index);
+						return ret;
+					}
+				}
+				if(r->used + size > r->buffer_size) {
+					ret = drain(r, 0);
+					if(ret < 0) {
+						_quicksand_consume(c, index);
+						return ret;
+					}
+				}
+				quicksand_log_record *record = (quicksand_log_record *) (r->buffer + r->used);
+				record->stamp = stamp;
+				record->length = (u32) length;
+				record->topic = (u32) t;
+				memcpy(record + 1, payload, (u64) length);
+				memset((u8 *) (record + 1) + length, 0,
+				       size - sizeof(quicksand_log_record) - (u64) length);
+				r->used += size;
+				r->records += 1;
+				r->bytes += (u64) length;
+				records += 1;
+			}
+			_quicksand_consume(c, index);
+		}
+	}
+	i64 ret = drain(r, 0);
+	return ret < 0 ? ret : records;
+}
+
+// ---------------------------------------------------------------------
+// quicksand_record_flush – write out the partial page as well
+// ---------------------------------------------------------------------
+i64 quicksand_record_flush(quicksand_recorder *r)
+{
+	if(!r || r->fd < 0) {
+		return -EINVAL;
+	}
+	return drain(r, 1);
+}
+
+// ---------------------------------------------------------------------
+// quicksand_record_close – flush, close and disconnect
+// ---------------------------------------------------------------------
+void quicksand_record_close(quicksand_recorder **recorder)
+{
+	if(!recorder || !*recorder) {
+		return;
+	}
+	quicksand_recorder *r = *recorder;
+	if(r->fd >= 0) {
+		drain(r, 1);
+		close((int) r->fd);
+	}
+	for(i64 i = 0; i < r->count; i += 1) {
+		quicksand_disconnect(&r->topics[i], NULL);
+	}
+	free(r->buffer);
+	free(r);
+	*recorder = NULL;
+}
@@ -1,22 +1,158 @@
 #define _POSIX_C_SOURCE 200809L
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 #include "quicksand.h"
+#include "quicksand_internal.h"
 #include "quicksand_style.h"
 
 // static calibration value for timer
 static volatile f64 NS_PER_TICK = 0.0;
 static volatile f64 TICK_PER_NS = 0.0;
 
+// Fixed-point calibration: ns = ticks * mult >> shift, packed as
+// [shift (32 bits)][mult (32 bits)] so readers load a consistent pair.
+static volatile u64 NS_SCALE = 0;
+
+// (tick, CLOCK_MONOTONIC) pair taken at startup for drift correction
+static u64 ANCHOR_TICK = 0;
+static u64 ANCHOR_NS = 0;
+
+// Set while the calibration only comes from a short measurement (or is
+// deferred until the first connect)
+static volatile u8 CLOCK_MEASURED = 0;
+
+// Set when the tick counter is not invariant: quicksand_now (assembly)
+// then returns CLOCK_MONOTONIC nanoseconds instead.
+__attribute__((used, visibility("hidden"))) volatile u8 QUICKSAND_CLOCK_FALLBACK = 0;
+
 extern u64 quicksand_now(void);
 
-f64 quicksand_ns(u64 final_timestamp, u64 initial_timestamp)
+// CLOCK_MONOTONIC in nanoseconds (quicksand_now fallback, from assembly)
+__attribute__((used)) u64 quicksand_now_monotonic(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * (u64) 1e9 + (u64) ts.tv_nsec;
+}
+
+// Update the floating point and fixed-point calibration together
+static void clock_set(f64 ns_per_tick)
+{
+	// Largest shift (most precision) that keeps mult within 32 bits
+	u64 shift = 32;
+	while(shift > 0 && ns_per_tick * (f64) (1ull << shift) >= 4294967295.0) {
+		shift -= 1;
+	}
+	u64 mult = (u64) (ns_per_tick * (f64) (1ull << shift) + 0.5); // (no libm)
+	NS_PER_TICK = ns_per_tick;
+	TICK_PER_NS = 1.0 / ns_per_tick;
+	NS_SCALE = (shift << 32) | mult;
+}
+
+// Read the tick counter and CLOCK_MONOTONIC as close together as possible
+static void clock_pair(u64 *tick, u64 *ns)
+{
+	u64 best = UINT64_MAX;
+	for(int i = 0; i < 8; i += 1) {
+		u64 before = quicksand_now_monotonic();
+		u64 now = quicksand_now();
+		u64 after = quicksand_now_monotonic();
+		if(after - before < best) {
+			best = after - before;
+			*tick = now;
+			*ns = before + (after - before) / 2;
+		}
+	}
+}
+
+// Tick frequency reported by the hardware, or 0 if unknown
+static f64 clock_hz(void)
+{
+#if defined(__x86_64__)
+	// CPUID 0x15: TSC = crystal clock * EBX / EAX
+	unsigned a, b, c, d;
+	if(__get_cpuid(0x15, &a, &b, &c, &d) && a && b && c) {
+		return (f64) c * (f64) b / (f64) a;
+	}
+	u64 khz = 0;
+	FILE *f = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r");
+	if(f) {
+		if(fscanf(f, "%lu", &khz) != 1) {
+			khz = 0;
+		}
+		fclose(f);
+	}
+	return (f64) khz * 1e3;
+#elif defined(__aarch64__)
+	u64 hz;
+	__asm__ volatile("mrs %0, cntfrq_el0" : "=r"(hz));
+	return (f64) hz;
+#else
+	return 0.0;
+#endif
+}
+
+// Whether the tick counter runs at a constant rate in all power states
+static i64 clock_invariant(void)
+{
+#if defined(__x86_64__)
+	unsigned a, b, c, d;
+	if(!__get_cpuid(0x80000007, &a, &b, &c, &d)) {
+		return 0;
+	}
+	return (d >> 8) & 1; // invariant TSC
+#else
+	return 1;
+#endif
+}
+
+// Calibrate once at load time so no hot path pays for it.  Without a
+// hardware frequency that is a 100 us measurement; a process started with
+// QUICKSAND_DEFER_CLOCK set skips it and takes the calibration from the
+// first topic it connects to instead (clock_deferred).
+__attribute__((constructor)) static void quicksand_clock_init(void)
+{
+	if(!clock_invariant()) {
+		QUICKSAND_CLOCK_FALLBACK = 1;
+		clock_set(1.0);
+	}
+	clock_pair(&ANCHOR_TICK, &ANCHOR_NS);
+	if(QUICKSAND_CLOCK_FALLBACK) {
+		return;
+	}
+	f64 hz = clock_hz();
+	if(hz > 0.0) {
+		clock_set(1e9 / hz);
+		return;
+	}
+	CLOCK_MEASURED = 1;
+	const char *defer = getenv("QUICKSAND_DEFER_CLOCK");
+	if(!defer || !defer[0] || !strcmp(defer, "0")) {
+		quicksand_ns_calibrate(100e3); // refined by quicksand_clock_sync
+	}
+}
+
+// internal - measure a deferred calibration when connecting gives us none
+static void clock_deferred(void)
 {
 	if(NS_PER_TICK <= 0.0) {
-		quicksand_ns_calibrate(1e6); // delay for 1 millisecond
+		quicksand_ns_calibrate(100e3);
 	}
+}
+
+f64 quicksand_ns(u64 final_timestamp, u64 initial_timestamp)
+{
 	f64 dir = 1.0;
 	// If overflow, direction is reversed (initial > final)
 	if(final_timestamp - initial_timestamp > (u64) 1e15) {
@@ -30,6 +166,185 @@ f64 quicksand_ns(u64 final_timestamp, u64 initial_timestamp)
 }
 
 
+// Split the ticks in 32-bit halves so both products fit in 64 bits
+// (and vectorize as 32x32->64 multiplies).
+static inline u64 ticks_ns(u64 ticks, u64 mult, u64 shift)
+{
+	u64 hi = ticks >> 32;
+	u64 lo = ticks & 0xffffffff;
+	return ((hi * mult) << (32 - shift)) + ((lo * mult) >> shift);
+}
+
+u64 quicksand_ticks_ns(u64 ticks)
+{
+	u64 scale = NS_SCALE;
+	return ticks_ns(ticks, scale & 0xffffffff, scale >> 32);
+}
+
+void quicksand_ticks_ns_array(const u64 *stamps, u64 *ns, i64 count, u64 base)
+{
+	u64 scale = NS_SCALE;
+	u64 mult = scale & 0xffffffff;
+	u64 shift = scale >> 32;
+	for(i64 i = 0; i < count; i += 1) {
+		ns[i] = ticks_ns(stamps[i] - base, mult, shift);
+	}
+}
+
+
+// ---------------------------------------------------------------------
+// Sequence locks in shared memory.  The holder stamps claimed with
+// CLOCK_MONOTONIC, so a lock held past the timeout is known to belong to
+// a dead process and the next writer takes it over.
+// ---------------------------------------------------------------------
+
+i64 _quicksand_seq_stale(volatile _Atomic(u64) *claimed)
+{
+	u64 stamp = atomic_load_explicit(claimed, memory_order_relaxed);
+	return stamp && quicksand_now_monotonic() - stamp > (u64) QUICKSAND_TIMEOUT;
+}
+
+i64 _quicksand_seq_lock(volatile _Atomic(u64) *sequence, volatile _Atomic(u64) *claimed,
+			f64 wait_ns)
+{
+	u64 start = quicksand_now_monotonic();
+	for(;;) {
+		u64 seen = atomic_load_explicit(sequence, memory_order_relaxed);
+		if(!(seen & 1)) {
+			if(atomic_compare_exchange_weak_explicit(sequence, &seen, seen + 1,
+								 memory_order_acquire, memory_order_relaxed)) {
+				break;
+			}
+			continue;
+		}
+		// Clearing the stamp first lets only one process take over
+		u64 stamp = atomic_load_explicit(claimed, memory_order_relaxed);
+		if(_quicksand_seq_stale(claimed)
+		   && atomic_compare_exchange_strong_explicit(claimed, &stamp, 0,
+							      memory_order_relaxed, memory_order_relaxed)
+		   && atomic_compare_exchange_strong_explicit(sequence, &seen, seen + 2,
+							      memory_order_acquire, memory_order_relaxed)) {
+			break; // (still odd)
+		}
+		if(quicksand_now_monotonic() - start >= (u64) wait_ns) {
+			return -EBUSY;
+		}
+		cpu_relax();
+	}
+	atomic_store_explicit(claimed, quicksand_now_monotonic(), memory_order_relaxed);
+	return 0;
+}
+
+void _quicksand_seq_unlock(volatile _Atomic(u64) *sequence, volatile _Atomic(u64) *claimed)
+{
+	atomic_store_explicit(claimed, 0, memory_order_relaxed);
+	atomic_fetch_add_explicit(sequence, 1, memory_order_release);
+}
+
+// ---------------------------------------------------------------------
+// Shared (per topic) calibration
+// ---------------------------------------------------------------------
+
+void quicksand_clock_update(quicksand_connection *c)
+{
+	quicksand_clock *clock = &c->buffer->clock;
+	clock_deferred();
+	if(_quicksand_seq_lock(&clock->sequence, &clock->claimed, 0.0)) {
+		return; // another process is publishing
+	}
+
+	u64 tick = 0, mono = 0;
+	clock_pair(&tick, &mono);
+	struct timespec real_ts;
+	u64 before = quicksand_now_monotonic();
+	clock_gettime(CLOCK_REALTIME, &real_ts);
+	u64 after = quicksand_now_monotonic();
+	u64 real = (u64) real_ts.tv_sec * (u64) 1e9 + (u64) real_ts.tv_nsec;
+
+	clock->ns_scale = NS_SCALE;
+	clock->ns_per_tick = NS_PER_TICK;
+	clock->tick = tick;
+	clock->monotonic_ns = mono;
+	clock->realtime_ns = real - (before + (after - before) / 2 - mono);
+	_quicksand_seq_unlock(&clock->sequence, &clock->claimed);
+}
+
+// Consistent snapshot of a topic calibration, 0 if never published.  An
+// update that never finishes reads as unpublished (after at most the
+// timeout, at once if it is stale) rather than hanging the reader.
+u64 _quicksand_clock_read(quicksand_clock *clock, quicksand_clock *out)
+{
+	u64 start = quicksand_now_monotonic();
+	for(;;) {
+		u64 sequence = atomic_load_explicit(&clock->sequence, memory_order_acquire);
+		out->ns_scale = clock->ns_scale;
+		out->ns_per_tick = clock->ns_per_tick;
+		out->tick = clock->tick;
+		out->monotonic_ns = clock->monotonic_ns;
+		out->realtime_ns = clock->realtime_ns;
+		atomic_thread_fence(memory_order_acquire);
+		if(!(sequence & 1)
+		   && sequence == atomic_load_explicit(&clock->sequence, memory_order_relaxed)) {
+			return sequence;
+		}
+		if(((sequence & 1) && _quicksand_seq_stale(&clock->claimed))
+		   || quicksand_now_monotonic() - start > (u64) QUICKSAND_TIMEOUT) {
+			*out = (quicksand_clock){0};
+			return 0;
+		}
+		sched_yield();
+	}
+}
+
+i64 quicksand_clock_adopt(quicksand_connection *c)
+{
+	quicksand_clock clock;
+	if(!_quicksand_clock_read(&c->buffer->clock, &clock) || clock.ns_per_tick <= 0.0
+	   || QUICKSAND_CLOCK_FALLBACK) {
+		return -1;
+	}
+	clock_set(clock.ns_per_tick);
+	CLOCK_MEASURED = 0;
+	return 0;
+}
+
+// Called on attach: prefer the topic's calibration over a short measurement
+i64 _quicksand_clock_attach(quicksand_connection *c)
+{
+	if(!CLOCK_MEASURED) {
+		return -1;
+	}
+	i64 adopted = quicksand_clock_adopt(c);
+	clock_deferred(); // (the topic had no calibration)
+	return adopted;
+}
+
+// Nanoseconds on the topic's reference clock for a slot timestamp
+static u64 stamp_ns(quicksand_clock *clock, u64 base_ns, u64 stamp)
+{
+	u64 mult = clock->ns_scale & 0xffffffff;
+	u64 shift = clock->ns_scale >> 32;
+	if((i64) (stamp - clock->tick) >= 0) {
+		return base_ns + ticks_ns(stamp - clock->tick, mult, shift);
+	}
+	return base_ns - ticks_ns(clock->tick - stamp, mult, shift);
+}
+
+u64 quicksand_stamp_monotonic(quicksand_connection *c, u64 stamp)
+{
+	quicksand_clock clock;
+	_quicksand_clock_read(&c->buffer->clock, &clock);
+	return stamp_ns(&clock, clock.monotonic_ns, stamp);
+}
+
+u64 quicksand_stamp_realtime(quicksand_connection *c, u64 stamp)
+{
+	quicksand_clock clock;
+	_quicksand_clock_read(&c->buffer->clock, &clock);
+	return stamp_ns(&clock, clock.realtime_ns, stamp);
+}
+
+
 // Calibrate conversion from timestamp counters to nanoseconds
 f64 quicksand_ns_calibrate(f64 nanoseconds)
 {
@@ -72,11 +387,63 @@ f64 quicksand_ns_calibrate(f64 nanoseconds)
 			- measurement_ns / 2;
 
 	// Update the calibration value
-	NS_PER_TICK = (double) elapsed_ns / (double) elapsed_ticks;
-	TICK_PER_NS = (double) elapsed_ticks / (double) elapsed_ns;
+	clock_set((double) elapsed_ns / (double) elapsed_ticks);
 	return NS_PER_TICK;
 }
 
+f64 quicksand_clock_sync(void)
+{
+	if(QUICKSAND_CLOCK_FALLBACK) {
+		return NS_PER_TICK;
+	}
+	u64 tick = 0, ns = 0;
+	clock_pair(&tick, &ns);
+	if(ns - ANCHOR_NS < (u64) 10e6) {
+		return NS_PER_TICK; // baseline too short to improve on startup value
+	}
+	clock_set((f64) (ns - ANCHOR_NS) / (f64) (tick - ANCHOR_TICK));
+	return NS_PER_TICK;
+}
+
+i64 quicksand_clock_invariant(void)
+{
+	return !QUICKSAND_CLOCK_FALLBACK;
+}
+
+static volatile f64 DISCIPLINE_PERIOD = 0.0;
+
+static void *clock_discipline(void *arg)
+{
+	(void) arg;
+	for(;;) {
+		struct timespec period = {
+				.tv_sec = (time_t) (DISCIPLINE_PERIOD * 1e-9),
+				.tv_nsec = (long) fmod(DISCIPLINE_PERIOD, 1e9)};
+		nanosleep(&period, NULL);
+		quicksand_clock_sync();
+	}
+	return NULL;
+}
+
+i64 quicksand_clock_discipline(f64 period_ns)
+{
+	if(period_ns < 1e6) {
+		return -1;
+	}
+	f64 running = DISCIPLINE_PERIOD;
+	DISCIPLINE_PERIOD = period_ns;
+	if(running > 0.0) {
+		return 0; // already running, period updated
+	}
+	pthread_t thread;
+	if(pthread_create(&thread, NULL, clock_discipline, NULL) != 0) {
+		DISCIPLINE_PERIOD = 0.0;
+		return -1;
+	}
+	pthread_detach(thread);
+	return 0;
+}
+
 void quicksand_sleep(double nanoseconds)
 {
 	if(nanoseconds < 0.0) {
@@ -109,3 +476,91 @@ void quicksand_sleep(double nanoseconds)
 		}
 	}
 }
+
+// ---------------------------------------------------------------------
+// Fixed-rate pacing
+// ---------------------------------------------------------------------
+
+// Sleep on the timer until spin_ns before the deadline, then busy-wait
+static void sleep_until(u64 deadline, f64 spin_ns)
+{
+	f64 remaining = quicksand_ns(deadline, quicksand_now());
+	if(remaining > spin_ns) {
+		u64 ns = (u64) (remaining - spin_ns);
+		struct timespec ts = {
+				.tv_sec = (time_t) (ns / (u64) 1e9),
+				.tv_nsec = (long) (ns % (u64) 1e9)};
+		nanosleep(&ts, NULL);
+	}
+	while((i64) (quicksand_now() - deadline) < 0) {
+		cpu_relax();
+	}
+}
+
+i64 quicksand_pacer_init(quicksand_pacer *p, f64 rate, i64 policy)
+{
+	if(!p || !(rate > 0.0)
+	   || (policy != QUICKSAND_PACE_CATCHUP && policy != QUICKSAND_PACE_DROP)) {
+		return -1;
+	}
+	p->period = 1e9 / rate * TICK_PER_NS;
+	p->start = quicksand_now();
+	p->next = 1;
+	p->policy = policy;
+	p->spin_ns = QUICKSAND_PACE_SPIN_NS;
+	p->count = 0;
+	p->missed = 0;
+	p->error_ns = 0.0;
+	p->error_max_ns = 0.0;
+	p->error_sum_ns = 0.0;
+	p->error_sq_ns = 0.0;
+	return 0;
+}
+
+i64 quicksand_pacer_spin(quicksand_pacer *p, f64 spin_ns)
+{
+	if(!p || !(spin_ns >= 0.0)) {
+		return -1;
+	}
+	p->spin_ns = spin_ns;
+	return 0;
+}
+
+i64 quicksand_pace(quicksand_pacer *p)
+{
+	u64 deadline = p->start + (u64) ((f64) p->next * p->period);
+	u64 now = quicksand_now();
+	i64 behind = 0;
+	if((i64) (now - deadline) < 0) {
+		sleep_until(deadline, p->spin_ns);
+		now = quicksand_now();
+	} else {
+		// overrun: deadlines that passed after this one
+		behind = (i64) ((f64) (now - p->start) / p->period) - (i64) p->next;
+		behind = behind > 0 ? behind : 0;
+		if(p->policy == QUICKSAND_PACE_DROP && behind > 0) {
+			p->next += (u64) behind;
+			p->missed += (u64) behind;
+			deadline = p->start + (u64) ((f64) p->next * p->period);
+		}
+	}
+
+	f64 error = quicksand_ns(now, deadline);
+	p->error_ns = error;
+	p->error_max_ns = error > p->error_max_ns ? error : p->error_max_ns;
+	p->error_sum_ns += error;
+	p->error_sq_ns += error * error;
+	p->next += 1;
+	p->count += 1;
+	return behind;
+}
+
+f64 quicksand_pacer_jitter(quicksand_pacer *p)
+{
+	if(!p->count) {
+		return 0.0;
+	}
+	f64 mean = p->error_sum_ns / (f64) p->count;
+	f64 variance = p->error_sq_ns / (f64) p->count - mean * mean;
+	return variance > 0.0 ? sqrt(variance) : 0.0;
+}
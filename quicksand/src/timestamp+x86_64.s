@@ -8,9 +8,13 @@
 	.p2align 4
 
 quicksand_now:
+	cmpb $0, QUICKSAND_CLOCK_FALLBACK(%rip) # TSC not invariant (time.c)
+	jne  1f
 	rdtsc            # RDX:RAX <- TSC
 	shlq $32, %rdx   # shift upper 32 bits into RDX
 	orq  %rdx, %rax  # combine them -> 64‑bit value in RAX
 	ret
+1:
+	jmp  quicksand_now_monotonic@PLT # CLOCK_MONOTONIC nanoseconds
 
 	.size   quicksand_now, .-quicksand_now
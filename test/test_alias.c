@@ -0,0 +1,93 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "quicksand.h"
+
+#define MESSAGES 100
+
+static void drain(quicksand_connection *c)
+{
+	int64_t value = 0, size = sizeof(value);
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		size = sizeof(value);
+		assert(quicksand_read(c, (uint8_t *) &value, &size) >= 0);
+		assert(size == sizeof(value) && value == i);
+	}
+	assert(quicksand_read(c, (uint8_t *) &value, &size) == -1);
+}
+
+int main()
+{
+	char *names[] = {"test_alias", "test_alias_left", "test_alias_right", "test_alias_chain",
+			 "test_alias_loop", "test_alias_other"};
+	for(int64_t i = 0; i < 6; i += 1) {
+		quicksand_delete(names[i], -1);
+	}
+	quicksand_connection *writer = NULL;
+	quicksand_connection *left = NULL;
+	quicksand_connection *right = NULL;
+	quicksand_connection *chain = NULL;
+	quicksand_options options = {.ring_length = 128};
+
+	// aliases may be made before the topic exists, or of another alias
+	assert(quicksand_alias("test_alias_left", "test_alias") == 0);
+	assert(quicksand_alias("test_alias_left", "test_alias") == 0); // (again)
+	assert(quicksand_alias("test_alias_left", "test_alias_other") == -EEXIST);
+	assert(quicksand_alias("test_alias_right", "test_alias") == 0);
+	assert(quicksand_alias("test_alias_chain", "test_alias_right") == 0);
+	assert(quicksand_connect(&left, "test_alias_left", -1, -1, -1, NULL) == -ENOENT);
+	assert(quicksand_connect_options(&writer, "test_alias", -1, 8, 1, &options, NULL) == 0);
+	assert(quicksand_alias("test_alias", "test_alias_other") == -EEXIST);
+
+	// one write reaches the readers of every name, each with its own cursor
+	assert(quicksand_connect(&left, "test_alias_left", -1, -1, -1, NULL) == 0);
+	assert(quicksand_connect(&right, "test_alias_right", -1, -1, -1, NULL) == 0);
+	assert(quicksand_connect(&chain, "test_alias_chain", -1, -1, -1, NULL) == 0);
+	assert(quicksand_register(left) == 0 && quicksand_register(right) == 0);
+	assert(quicksand_register(chain) == 0);
+	assert(left->buffer == writer->buffer && chain->buffer == writer->buffer);
+	assert(strcmp((char *) chain->name, "test_alias") == 0);
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &i, sizeof(i)) == 0);
+	}
+	drain(left);
+	drain(right);
+	drain(chain);
+	quicksand_disconnect(&chain, NULL);
+
+	// writers connect through an alias too (and still check the geometry)
+	quicksand_connection *second = NULL;
+	assert(quicksand_connect_options(&second, "test_alias_chain", -1, 8, 1, &options,
+					 NULL) == 0);
+	assert(second->buffer == writer->buffer);
+	quicksand_disconnect(&second, NULL);
+	assert(quicksand_connect_options(&second, "test_alias_chain", -1, 8, 1, NULL, NULL)
+	       == -EINVAL);
+
+	// readers of an alias follow the topic when it grows
+	assert(quicksand_grow(writer, 100, -1) == 0);
+	int64_t value = 7, size = sizeof(value);
+	assert(quicksand_write(writer, (uint8_t *) &value, sizeof(value)) == 0);
+	value = 0;
+	assert(quicksand_read(left, (uint8_t *) &value, &size) >= 0 && value == 7);
+	assert(left->buffer == writer->buffer);
+
+	// cycles are reported, deleted aliases are gone
+	assert(quicksand_alias("test_alias_loop", "test_alias_loop") == -ELOOP);
+	assert(quicksand_alias("test_alias_loop", "test_alias_other") == 0);
+	assert(quicksand_alias("test_alias_other", "test_alias_loop") == 0);
+	assert(quicksand_connect(&chain, "test_alias_loop", -1, -1, -1, NULL) == -ELOOP);
+	assert(quicksand_connect_options(&chain, "test_alias_loop", -1, 8, 1, NULL, NULL) == -ELOOP);
+	quicksand_delete("test_alias_chain", -1);
+	assert(quicksand_connect(&chain, "test_alias_chain", -1, -1, -1, NULL) == -ENOENT);
+
+	quicksand_disconnect(&left, NULL);
+	quicksand_disconnect(&right, NULL);
+	quicksand_disconnect(&writer, NULL);
+	for(int64_t i = 0; i < 6; i += 1) {
+		quicksand_delete(names[i], -1);
+	}
+}
@@ -0,0 +1,68 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "quicksand.h"
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_backpressure", -1);
+	int64_t success1 = quicksand_connect(&writer, "test_backpressure", -1, 8, 8, NULL);
+	int64_t success2 = quicksand_connect(&reader, "test_backpressure", -1, -1, -1, NULL);
+	assert(success1 == 0 && writer);
+	assert(success2 == 0 && reader);
+	assert(writer->buffer->length == 8);
+
+	// fail fast once the registered reader would be lapped
+	assert(quicksand_register(reader) == 0);
+	assert(quicksand_backpressure(writer, QUICKSAND_FAIL, NULL, 0) == 0);
+	int64_t data = 0;
+	for(; data < 8; data += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	}
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == -EAGAIN);
+
+	int64_t value = -1;
+	int64_t size = sizeof(value);
+	assert(quicksand_read(reader, (uint8_t *) &value, &size) == 7);
+	assert(value == 0);
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	data += 1;
+
+	// spill to the side buffer and flush in order
+	uint8_t spill[256];
+	assert(quicksand_backpressure(writer, QUICKSAND_SPILL, spill, sizeof(spill)) == 0);
+	for(int i = 0; i < 4; i += 1, data += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	}
+	assert(quicksand_flush(writer) == -EAGAIN);
+	int64_t expect = 1;
+	while(expect < data) {
+		size = sizeof(value);
+		if(quicksand_read(reader, (uint8_t *) &value, &size) < 0) {
+			quicksand_flush(writer); // reader caught up, publish the rest
+			continue;
+		}
+		assert(value == expect);
+		expect += 1;
+	}
+	assert(quicksand_flush(writer) == 0);
+
+	// blocking writers time out on a stalled reader
+	assert(quicksand_backpressure(writer, QUICKSAND_BLOCK, NULL, 0) == 0);
+	for(int i = 0; i < 8; i += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	}
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == -ETIMEDOUT);
+
+	// unregistered readers do not hold writers back
+	quicksand_unregister(reader);
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_backpressure", -1);
+	return 0;
+}
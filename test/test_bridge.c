@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 200809L
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+#define MESSAGES 20000
+#define SIZE(i) ((i) % 16 == 0 ? 6000 : 8 + (i) % 57)
+
+// Receiving host: mirror senders until each one closes
+static int mirror(int64_t listener, int64_t senders)
+{
+	for(int64_t s = 0; s < senders; s += 1) {
+		quicksand_bridge *b = NULL;
+		assert(quicksand_bridge_accept(&b, listener, "mirror_") == 0);
+		assert(strcmp((char *) b->topic->name, "mirror_test_bridge") == 0);
+		int64_t ret;
+		while((ret = quicksand_bridge_poll(b)) >= 0) {
+			if(ret == 0) {
+				quicksand_sleep(20e3);
+			}
+		}
+		assert(ret == -EPIPE);
+		if(s == 0) {
+			assert(b->messages == MESSAGES && b->dropped == 0);
+			assert(b->sends < MESSAGES / 4); // coalesced
+		} else {
+			assert(b->dropped > 0); // sender overruns are reported
+		}
+		quicksand_bridge_close(&b);
+	}
+	return 0;
+}
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_bridge", -1);
+	quicksand_delete("mirror_test_bridge", -1);
+	quicksand_options options = {.ring_length = 64};
+	assert(quicksand_connect_options(&writer, "test_bridge", -1, 8192, 1, &options, NULL) == 0);
+
+	int64_t listener = quicksand_bridge_listen("127.0.0.1", 0);
+	assert(listener >= 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	assert(getsockname((int) listener, (struct sockaddr *) &addr, &len) == 0);
+	int64_t port = ntohs(addr.sin_port);
+	assert(quicksand_bridge_listen("not an address", 0) == -EINVAL);
+	int64_t named = quicksand_bridge_listen("localhost", 0); // (resolved)
+	assert(named >= 0);
+	close((int) named);
+
+	pid_t pid = fork();
+	if(pid == 0) {
+		_exit(mirror(listener, 2));
+	}
+	quicksand_bridge *b = NULL;
+	assert(quicksand_bridge_send(&b, "test_bridge", "localhost", port, 1) == 0);
+	if(!b->uring) {
+		fprintf(stderr, "io_uring unavailable, testing the copying sender\n");
+	}
+
+	// the mirror has the same geometry
+	assert(quicksand_connect(&reader, "mirror_test_bridge", -1, -1, -1, NULL) == 0);
+	assert(reader->mask == writer->mask && reader->max_payload == writer->max_payload);
+	assert(quicksand_register(reader) == 0);
+
+	// small messages and some large enough to be sent zero-copy
+	static uint8_t message[8192];
+	static int64_t value[1024];
+	int64_t next = 0;
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		memcpy(message, &i, sizeof(i));
+		message[SIZE(i) - 1] = SIZE(i) > 8 ? (uint8_t) i : message[SIZE(i) - 1];
+		assert(quicksand_write(writer, message, SIZE(i)) == 0);
+		if(i % 64 == 63 || i == MESSAGES - 1) {
+			assert(quicksand_bridge_poll(b) > 0);
+		}
+		int64_t size = sizeof(value);
+		while(quicksand_read(reader, (uint8_t *) value, &size) >= 0) {
+			assert(value[0] == next && size == SIZE(next));
+			assert(size == 8 || ((uint8_t *) value)[size - 1] == (uint8_t) next);
+			next += 1;
+			size = sizeof(value);
+		}
+	}
+	uint64_t start = quicksand_now();
+	while(next < MESSAGES && quicksand_ns(quicksand_now(), start) < 5e9) {
+		int64_t size = sizeof(value);
+		if(quicksand_read(reader, (uint8_t *) value, &size) >= 0) {
+			assert(value[0] == next);
+			next += 1;
+		}
+	}
+	assert(next == MESSAGES);
+	assert(b->messages == MESSAGES && b->dropped == 0 && b->sends < MESSAGES / 32);
+	quicksand_bridge_close(&b);
+
+	// a lossy bridge that falls behind counts what it skipped
+	assert(quicksand_bridge_send(&b, "test_bridge", "127.0.0.1", port, 0) == 0);
+	assert(!b->uring); // (copies)
+	for(int64_t i = 0; i < 4096; i += 1) {
+		assert(quicksand_write(writer, message, 8) == 0);
+	}
+	assert(quicksand_bridge_poll(b) > 0);
+	assert(b->dropped > 0 && b->messages + b->dropped == 4096);
+	quicksand_bridge_close(&b);
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	close((int) listener);
+	assert(quicksand_bridge_send(&b, "test_bridge", "127.0.0.1", port, 0) == -ECONNREFUSED);
+
+	// a sender cannot make the receiver create a file
+	listener = quicksand_bridge_listen("127.0.0.1", 0);
+	assert(listener >= 0 && getsockname((int) listener, (struct sockaddr *) &addr, &len) == 0);
+	int raw = socket(AF_INET, SOCK_STREAM, 0);
+	assert(connect(raw, (struct sockaddr *) &addr, len) == 0);
+	quicksand_bridge_hello hello = {.magic = QUICKSAND_BRIDGE_MAGIC,
+					.version = QUICKSAND_BRIDGE_VERSION,
+					.length = 16,
+					.message_size = 64};
+	strcpy(hello.name, "/test_bridge_dir/escape");
+	assert(send(raw, &hello, sizeof(hello), 0) == sizeof(hello));
+	assert(quicksand_bridge_accept(&b, listener, "mirror_") == -EINVAL);
+	assert(access("mirror_/test_bridge_dir/escape", F_OK) == -1);
+	close(raw);
+	close((int) listener);
+
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_bridge", -1);
+	quicksand_delete("mirror_test_bridge", -1);
+}
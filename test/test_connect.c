@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+// Connect latency: what a short-lived process pays to attach to its topics
+#define TOPICS 32
+#define ROUNDS 20
+
+extern char **environ;
+
+static void topic_name(char *name, int64_t i)
+{
+	snprintf(name, 64, "test_connect_%ld", (long) i);
+}
+
+// Child process: attach to every topic (or only start) and exit
+static int child(int64_t connect)
+{
+	quicksand_connection *c[TOPICS] = {NULL};
+	char name[64];
+	for(int64_t i = 0; i < TOPICS && connect; i += 1) {
+		topic_name(name, i);
+		assert(quicksand_connect(&c[i], name, -1, -1, -1, NULL) == 0);
+		assert(c[i]->mask == 15);
+	}
+	// (started with a deferred clock: connecting supplies the calibration)
+	assert(!connect || quicksand_ns(1000, 0) > 0.0);
+	for(int64_t i = 0; i < TOPICS && connect; i += 1) {
+		quicksand_disconnect(&c[i], NULL);
+	}
+	return 0;
+}
+
+static double spawn_us(char *self, char *mode)
+{
+	char *argv[] = {self, mode, NULL};
+	uint64_t start = quicksand_now();
+	for(int64_t r = 0; r < ROUNDS; r += 1) {
+		pid_t pid;
+		assert(posix_spawn(&pid, self, NULL, NULL, argv, environ) == 0);
+		int status = 0;
+		waitpid(pid, &status, 0);
+		assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	return quicksand_ns(quicksand_now(), start) * 1e-3 / ROUNDS;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1) {
+		return child(strcmp(argv[1], "connect") == 0);
+	}
+	quicksand_connection *writers[TOPICS] = {NULL};
+	char name[64];
+	quicksand_options options = {.ring_length = 16};
+	uint64_t start = quicksand_now();
+	for(int64_t i = 0; i < TOPICS; i += 1) {
+		topic_name(name, i);
+		quicksand_delete(name, -1);
+		assert(quicksand_connect_options(&writers[i], name, -1, 64, 1, &options, NULL) == 0);
+	}
+	double create = quicksand_ns(quicksand_now(), start) * 1e-3 / TOPICS;
+
+	// Attaching from this process (the first connection maps the topic)
+	quicksand_connection *c = NULL;
+	start = quicksand_now();
+	for(int64_t r = 0; r < ROUNDS; r += 1) {
+		quicksand_disconnect(&writers[r % TOPICS], NULL);
+		topic_name(name, r % TOPICS);
+		assert(quicksand_connect_options(&writers[r % TOPICS], name, -1, 64, 1, &options,
+						 NULL) == 0);
+	}
+	double writer = quicksand_ns(quicksand_now(), start) * 1e-3 / ROUNDS;
+	for(int64_t i = 0; i < TOPICS; i += 1) {
+		quicksand_disconnect(&writers[i], NULL);
+	}
+	start = quicksand_now();
+	for(int64_t r = 0; r < ROUNDS * TOPICS; r += 1) {
+		topic_name(name, r % TOPICS);
+		assert(quicksand_connect(&c, name, -1, -1, -1, NULL) == 0);
+		quicksand_disconnect(&c, NULL);
+	}
+	double reader = quicksand_ns(quicksand_now(), start) * 1e-3 / (ROUNDS * TOPICS);
+
+	// Topics passed over a unix socket to a process that reads them
+	int sockets[2];
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+	pid_t pid = fork();
+	if(pid == 0) {
+		close(sockets[0]);
+		for(int64_t i = 0; i < 2; i += 1) {
+			quicksand_connection *passed = NULL;
+			assert(quicksand_recv_topic(sockets[1], &passed, NULL) == 0);
+			topic_name(name, i);
+			assert(strcmp((char *) passed->name, name) == 0 && passed->mask == 15);
+			int64_t value = 0, size = sizeof(value);
+			assert(quicksand_read(passed, (uint8_t *) &value, &size) >= 0);
+			assert(size == sizeof(value) && value == 100 + i);
+			quicksand_disconnect(&passed, NULL);
+		}
+		assert(quicksand_recv_topic(sockets[1], &c, NULL) == -EPIPE);
+		_exit(0);
+	}
+	close(sockets[1]);
+	for(int64_t i = 0; i < 2; i += 1) {
+		topic_name(name, i);
+		assert(quicksand_connect_options(&writers[i], name, -1, 64, 1, &options, NULL) == 0);
+		int64_t value = 100 + i;
+		assert(quicksand_write(writers[i], (uint8_t *) &value, sizeof(value)) == 0);
+		assert(quicksand_send_topic(sockets[0], writers[i]) == 0);
+	}
+	close(sockets[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	assert(quicksand_send_topic(sockets[0], writers[0]) == -EBADF);
+	assert(quicksand_connect_fd(&c, -1, "test_connect_0", NULL) == -EINVAL);
+	quicksand_disconnect(&writers[0], NULL);
+	quicksand_disconnect(&writers[1], NULL);
+
+	// Short-lived processes attaching to every topic, minus process startup
+	setenv("QUICKSAND_DEFER_CLOCK", "1", 1);
+	double empty = spawn_us(argv[0], "empty");
+	double spawned = spawn_us(argv[0], "connect");
+	printf("connect: create %.1f us, writer attach %.1f us, reader attach %.1f us\n",
+	       create, writer, reader);
+	printf("connect: process start %.1f us, +%d topics %.1f us (%.1f us per topic)\n",
+	       empty, TOPICS, spawned - empty, (spawned - empty) / TOPICS);
+
+	for(int64_t i = 0; i < TOPICS; i += 1) {
+		topic_name(name, i);
+		quicksand_delete(name, -1);
+	}
+}
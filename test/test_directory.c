@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+#define CHILDREN 4
+#define TOPICS 32
+
+static int listed(quicksand_topic_info *topics, int64_t count, char *name)
+{
+	int found = 0;
+	for(int64_t i = 0; i < count; i += 1) {
+		found += strcmp(topics[i].name, name) == 0;
+	}
+	return found;
+}
+
+int main()
+{
+	static quicksand_topic_info topics[QUICKSAND_DIRECTORY_SLOTS];
+	quicksand_topic_info info;
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_directory", -1);
+	assert(quicksand_directory_find("test_directory", &info) == -ENOENT);
+
+	// creating a topic lists it with its geometry and creator
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t before = (uint64_t) ts.tv_sec * (uint64_t) 1e9 + (uint64_t) ts.tv_nsec;
+	quicksand_options options = {.ring_length = 16, .grow = 1};
+	assert(quicksand_connect_options(&writer, "test_directory", -1, 40, 1, &options, NULL) == 0);
+	assert(quicksand_directory_find("test_directory", &info) == 0);
+	assert(strcmp(info.name, "test_directory") == 0);
+	assert(info.length == 16 && (int64_t) info.message_size == writer->max_payload);
+	assert(info.generation == 0 && info.type == 0);
+	assert(info.pid == (uint64_t) getpid() && info.created_ns >= before);
+	int64_t count = quicksand_directory_list(topics, QUICKSAND_DIRECTORY_SLOTS);
+	assert(count > 0 && listed(topics, count, "test_directory") == 1);
+	assert(quicksand_directory_list(NULL, 0) == count);
+
+	// growth updates the geometry, readers change nothing
+	assert(quicksand_grow(writer, 100, 64) == 0);
+	assert(quicksand_connect(&reader, "test_directory", -1, -1, -1, NULL) == 0);
+	uint64_t created = info.created_ns;
+	assert(quicksand_directory_find("test_directory", &info) == 0);
+	assert(info.length == 64 && (int64_t) info.message_size == writer->max_payload);
+	assert(info.generation == 1 && info.created_ns == created);
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+
+	// deleting unlists it
+	quicksand_delete("test_directory", -1);
+	assert(quicksand_directory_find("test_directory", &info) == -ENOENT);
+	count = quicksand_directory_list(topics, QUICKSAND_DIRECTORY_SLOTS);
+	assert(listed(topics, count, "test_directory") == 0);
+
+	// processes racing to list names (one shared by all) get one entry each
+	for(int64_t child = 0; child < CHILDREN; child += 1) {
+		if(fork() == 0) {
+			char name[64];
+			for(int64_t i = 0; i < TOPICS; i += 1) {
+				quicksand_connection *c = NULL;
+				snprintf(name, sizeof(name), "test_directory_%ld_%ld", (long) child, (long) i);
+				assert(quicksand_connect(&c, name, -1, 8, 16, NULL) == 0);
+				quicksand_disconnect(&c, NULL);
+				assert(quicksand_connect(&c, "test_directory_shared", -1, 8, 16, NULL) == 0);
+				quicksand_disconnect(&c, NULL);
+			}
+			_exit(0);
+		}
+	}
+	for(int64_t child = 0; child < CHILDREN; child += 1) {
+		int status = 0;
+		wait(&status);
+		assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	count = quicksand_directory_list(topics, QUICKSAND_DIRECTORY_SLOTS);
+	assert(listed(topics, count, "test_directory_shared") == 1);
+	char name[64];
+	for(int64_t child = 0; child < CHILDREN; child += 1) {
+		for(int64_t i = 0; i < TOPICS; i += 1) {
+			snprintf(name, sizeof(name), "test_directory_%ld_%ld", (long) child, (long) i);
+			assert(listed(topics, count, name) == 1);
+			assert(quicksand_directory_find(name, &info) == 0 && info.length == 16);
+			quicksand_delete(name, -1);
+		}
+	}
+	quicksand_delete("test_directory_shared", -1);
+	assert(quicksand_directory_find("test_directory_shared", &info) == -ENOENT);
+
+	// deleted entries are reused, so churning names never fills the table
+	for(int64_t i = 0; i < 2 * QUICKSAND_DIRECTORY_SLOTS; i += 1) {
+		quicksand_connection *c = NULL;
+		snprintf(name, sizeof(name), "test_directory_churn_%ld", (long) i);
+		assert(quicksand_connect(&c, name, -1, 8, 2, NULL) == 0);
+		assert(quicksand_directory_find(name, &info) == 0);
+		quicksand_disconnect(&c, NULL);
+		quicksand_delete(name, -1);
+	}
+	assert(quicksand_directory_find(NULL, &info) == -EINVAL);
+	assert(quicksand_directory_list(NULL, 4) == -EINVAL);
+}
@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+int main()
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/test_file.%d.qs", (int) getpid());
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_options options = {.ring_length = 64, .sync = QUICKSAND_SYNC_MSYNC};
+
+	// durability policies only apply to files
+	assert(quicksand_connect_options(&writer, "test_file", -1, 8, 1, &options, NULL) == -EINVAL);
+	options.sync = 3;
+	assert(quicksand_connect_options(&writer, path, -1, 8, 1, &options, NULL) == -EINVAL);
+	options.sync = QUICKSAND_SYNC_MSYNC;
+
+	assert(quicksand_connect_options(&writer, path, -1, 8, 1, &options, NULL) == 0);
+	quicksand_ringbuffer *rb = writer->buffer;
+	assert(writer->sync == QUICKSAND_SYNC_MSYNC && rb->sync == QUICKSAND_SYNC_MSYNC);
+	assert(rb->compat & QUICKSAND_COMPAT_SYNC);
+	struct stat sb;
+	assert(stat(path, &sb) == 0 && (uint64_t) sb.st_size == writer->shared_memory_size);
+	for(int64_t i = 0; i < 10; i += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &i, sizeof(i)) == 0);
+	}
+	assert(quicksand_sync(writer) == 0);
+	quicksand_disconnect(&writer, NULL);
+
+	// the messages are still there once every process has let go
+	assert(quicksand_connect(&reader, path, -1, -1, -1, NULL) == 0);
+	assert(reader->sync == QUICKSAND_SYNC_MSYNC);
+	int64_t value = -1;
+	int64_t size = sizeof(value);
+	for(int64_t i = 0; i < 10; i += 1) {
+		assert(quicksand_read(reader, (uint8_t *) &value, &size) >= 0);
+		assert(value == i);
+	}
+	assert(quicksand_read(reader, (uint8_t *) &value, &size) == -1);
+
+	// after a reboot the locks, reservations and peers of the old boot
+	// are dropped, but the messages stay
+	rb = reader->buffer;
+	uint64_t boot = rb->boot;
+	assert(boot > 1);
+	rb->boot = boot ^ 0x5a5a;
+	rb->locked = 12345;
+	rb->reserve = rb->index + 3;
+	rb->peers[5].state = 2;
+	rb->peers[5].role = QUICKSAND_ROLE_READER | QUICKSAND_ROLE_RELIABLE;
+	quicksand_disconnect(&reader, NULL);
+
+	options.sync = QUICKSAND_SYNC_FDATASYNC; // (the topic keeps its own)
+	assert(quicksand_connect_options(&writer, path, -1, 8, 1, &options, NULL) == 0);
+	rb = writer->buffer;
+	assert(rb->boot == boot && rb->locked == 0 && rb->reserve == rb->index);
+	assert(rb->peers[5].state == 0);
+	assert(rb->clock.ns_per_tick > 0.0);
+	assert(writer->sync == QUICKSAND_SYNC_MSYNC);
+	assert(quicksand_connect(&reader, path, -1, -1, -1, NULL) == 0);
+	value = 10;
+	assert(quicksand_write(writer, (uint8_t *) &value, sizeof(value)) == 0);
+	for(int64_t i = 0; i < 11; i += 1) {
+		assert(quicksand_read(reader, (uint8_t *) &value, &size) >= 0);
+		assert(value == i);
+	}
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+
+	// fdatasync policy, growth keeps the file backend
+	quicksand_delete(path, -1);
+	assert(stat(path, &sb) != 0);
+	options.grow = 1;
+	assert(quicksand_connect_options(&writer, path, -1, 8, 1, &options, NULL) == 0);
+	assert(writer->sync == QUICKSAND_SYNC_FDATASYNC);
+	value = 1;
+	assert(quicksand_write(writer, (uint8_t *) &value, sizeof(value)) == 0);
+	assert(quicksand_grow(writer, 256, 128) == 0);
+	assert(writer->mask + 1 == 128 && writer->sync == QUICKSAND_SYNC_FDATASYNC);
+	assert(stat(path, &sb) == 0 && (uint64_t) sb.st_size == writer->shared_memory_size);
+	assert(quicksand_write(writer, (uint8_t *) &value, sizeof(value)) == 0);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete(path, -1);
+
+	// shared memory topics have nothing to sync
+	assert(quicksand_connect(&writer, "test_file", -1, 8, 64, NULL) == 0);
+	assert(quicksand_sync(writer) == -EINVAL && writer->sync == 0);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_file", -1);
+}
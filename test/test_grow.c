@@ -0,0 +1,108 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "quicksand.h"
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_grow", -1);
+	int64_t success1 = quicksand_connect(&writer, "test_grow", -1, 8, 8, NULL);
+	int64_t success2 = quicksand_connect(&reader, "test_grow", -1, -1, -1, NULL);
+	assert(success1 == 0 && writer);
+	assert(success2 == 0 && reader);
+
+	uint8_t small[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	uint8_t big[100];
+	memset(big, 9, sizeof(big));
+	assert(quicksand_write(writer, small, sizeof(small)) == 0);
+	assert(quicksand_write(writer, big, sizeof(big)) == -EMSGSIZE);
+
+	// grow in place: the writer moves, the reader still drains the old ring
+	assert(quicksand_grow(writer, 128, 16) == 0);
+	assert(writer->buffer->length == 16);
+	assert(writer->buffer->generation == 1);
+	assert(quicksand_write(writer, big, sizeof(big)) == 0);
+
+	uint8_t buf[256];
+	int64_t size = sizeof(buf);
+	assert(quicksand_read(reader, buf, &size) == 0);
+	assert(size == sizeof(small) && buf[0] == 1);
+	assert(reader->buffer->generation == 0);
+	size = sizeof(buf);
+	assert(quicksand_read(reader, buf, &size) == 0);
+	assert(size == sizeof(big) && buf[0] == 9);
+	assert(reader->buffer->generation == 1);
+
+	// a mismatched creator only grows the topic if asked to
+	quicksand_connection *writer_big = NULL;
+	assert(quicksand_connect(&writer_big, "test_grow", -1, 512, 16, NULL) < 0);
+	quicksand_options grow = {.grow = 1};
+	assert(quicksand_connect_options(&writer_big, "test_grow", -1, 512, 16,
+					 &grow, NULL)
+	       == 0);
+	assert(writer_big->buffer->generation == 2);
+	assert(writer_big->buffer->message_size >= 512);
+
+	// growing connections also grow on oversized writes
+	uint8_t huge[1024];
+	memset(huge, 7, sizeof(huge));
+	assert(quicksand_write(writer_big, huge, sizeof(huge)) == 0);
+	assert(writer_big->buffer->generation == 3);
+	assert(quicksand_write(writer, small, sizeof(small)) == 0);
+	assert(writer->buffer->generation == 3);
+
+	size = sizeof(buf);
+	assert(quicksand_read(reader, buf, &size) == -EINVAL); // too short
+	uint8_t large[2048];
+	size = sizeof(large);
+	assert(quicksand_read(reader, large, &size) == 0);
+	assert(size == sizeof(small) && large[0] == 1);
+
+	// registered readers hold writers back on the new ring too
+	assert(quicksand_register(reader) == 0);
+	assert(quicksand_backpressure(writer, QUICKSAND_FAIL, NULL, 0) == 0);
+	assert(quicksand_write(writer, small, sizeof(small)) == 0);
+	assert(quicksand_grow(writer, 8, 32) == 0);
+	assert(writer->buffer->generation == 4);
+	int64_t count = 0;
+	while(quicksand_write(writer, small, sizeof(small)) == 0) {
+		count += 1;
+	}
+	assert(count == 32);
+	for(count = 0; count < 33; count += 1) {
+		size = sizeof(large);
+		assert(quicksand_read(reader, large, &size) >= 0);
+	}
+	assert(reader->buffer->generation == 4);
+	assert(quicksand_read(reader, large, &size) == -1);
+	assert(quicksand_write(writer, small, sizeof(small)) == 0);
+
+	// a reader registering after the registry was copied carries itself over
+	quicksand_connection *late = NULL;
+	assert(quicksand_connect(&late, "test_grow", -1, -1, -1, NULL) == 0);
+	quicksand_unregister(reader);
+	assert(quicksand_grow(writer, 8, 64) == 0);
+	assert(late->buffer->generation == 4);
+	assert(quicksand_register(late) == 0);
+	for(count = 0; count < 1000 && quicksand_write(writer, small, sizeof(small)) == 0;) {
+		count += 1;
+	}
+	assert(count == 64);
+	for(count = 0; count < 64; count += 1) {
+		size = sizeof(large);
+		assert(quicksand_read(late, large, &size) >= 0);
+	}
+	assert(late->buffer->generation == 5);
+	assert(quicksand_read(late, large, &size) == -1);
+	quicksand_disconnect(&late, NULL);
+
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_disconnect(&writer_big, NULL);
+	quicksand_delete("test_grow", -1);
+	return 0;
+}
@@ -0,0 +1,64 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "quicksand.h"
+
+int main()
+{
+	quicksand_histogram *histogram = malloc(sizeof(quicksand_histogram));
+	assert(histogram);
+
+	// exact below 64 ticks, within 1/32 above
+	quicksand_histogram_reset(histogram);
+	assert(quicksand_histogram_percentile(histogram, 50.0) == 0.0);
+	for(uint64_t value = 1; value <= 100000; value += 1) {
+		quicksand_histogram_record(histogram, value);
+	}
+	assert(histogram->count == 100000);
+	assert(histogram->min == 1 && histogram->max == 100000);
+	double tick_ns = (double) quicksand_ticks_ns(1 << 20) / (double) (1 << 20);
+	double p50 = quicksand_histogram_percentile(histogram, 50.0) / tick_ns;
+	double p99 = quicksand_histogram_percentile(histogram, 99.0) / tick_ns;
+	assert(p50 >= 50000.0 * 0.99 && p50 <= 50000.0 * (1.0 + 1.0 / 32.0) + 2.0);
+	assert(p99 >= 99000.0 * 0.99 && p99 <= 99000.0 * (1.0 + 1.0 / 32.0) + 2.0);
+	assert(quicksand_histogram_percentile(histogram, 100.0)
+	       == (double) quicksand_ticks_ns(100000));
+	quicksand_histogram_record(histogram, UINT64_MAX);
+	assert(histogram->max == UINT64_MAX);
+
+	// readers record the time from write to read
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_latency", -1);
+	assert(quicksand_connect(&writer, "test_latency", -1, 8, 64, NULL) == 0);
+	assert(quicksand_connect(&reader, "test_latency", -1, -1, -1, NULL) == 0);
+	assert(reader->latency == NULL);
+	assert(quicksand_latency(reader, histogram) == 0);
+	assert(histogram->count == 0);
+
+	int64_t value = 0;
+	int64_t size = sizeof(value);
+	for(int64_t i = 0; i < 8; i += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &i, sizeof(i)) == 0);
+		quicksand_sleep(100e3);
+		size = sizeof(value);
+		assert(quicksand_read(reader, (uint8_t *) &value, &size) == 0);
+		assert(value == i);
+	}
+	assert(histogram->count == 8);
+	double median = quicksand_histogram_percentile(histogram, 50.0);
+	assert(median >= 100e3 && median < 100e6);
+
+	quicksand_latency(reader, NULL);
+	assert(quicksand_write(writer, (uint8_t *) &value, sizeof(value)) == 0);
+	size = sizeof(value);
+	assert(quicksand_read(reader, (uint8_t *) &value, &size) == 0);
+	assert(histogram->count == 8);
+
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_latency", -1);
+	free(histogram);
+}
@@ -0,0 +1,104 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_layout", -1);
+	int64_t success1 = quicksand_connect(&writer, "test_layout", -1, 32, 100, NULL);
+	int64_t success2 = quicksand_connect(&reader, "test_layout", -1, -1, -1, NULL);
+	assert(success1 == 0 && writer);
+	assert(success2 == 0 && reader);
+
+	// segments carry the format and readers cache the geometry
+	assert(writer->buffer->magic == QUICKSAND_MAGIC);
+	assert(writer->buffer->version == QUICKSAND_VERSION);
+	assert(reader->mask == reader->buffer->length - 1);
+	assert(reader->stride == reader->buffer->message_size);
+	assert(reader->max_payload >= 32 && reader->data == writer->data);
+
+	uint8_t data[5] = {1, 2, 3, 4, 5};
+	int64_t size = sizeof(data);
+	quicksand_write(writer, data, sizeof(data));
+	assert(quicksand_read(reader, data, &size) == 0);
+	uint64_t read_stamp = reader->read_stamp;
+	assert(quicksand_read(reader, data, &size) == -1);
+	assert(reader->read_stamp == read_stamp); // empty reads write nothing
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_layout", -1);
+
+	// ring depth independent of message rate
+	quicksand_options slots = {.ring_length = 16};
+	int64_t success3 = quicksand_connect_options(&writer, "test_layout", -1, 32, 1000000,
+						     &slots, NULL);
+	assert(success3 == 0 && writer);
+	assert(writer->buffer->length == 16);
+
+	// slot padding past a payload is zeroed (senders put it on the wire)
+	uint8_t ones[16] = {0};
+	for(int64_t i = 0; i < 16; i += 1) {
+		ones[i] = 0xff;
+	}
+	for(int64_t i = 0; i < 16; i += 1) {
+		assert(quicksand_write(writer, ones, sizeof(ones)) == 0);
+	}
+	assert(quicksand_write(writer, ones, 9) == 0);
+	uint8_t *slot = writer->data + (writer->stride - writer->max_payload);
+	for(int64_t i = 0; i < 16; i += 1) {
+		assert(slot[i] == (i < 9 ? 0xff : 0));
+	}
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_layout", -1);
+
+	quicksand_options depth = {.ring_ns = 20e6}; // 20 ms at 1 MHz
+	int64_t success4 = quicksand_connect_options(&writer, "test_layout", -1, 32, 1000000,
+						     &depth, NULL);
+	assert(success4 == 0 && writer);
+	assert(writer->buffer->length == 32768);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_layout", -1);
+
+	// header fields that different parties write live on separate lines
+	assert(offsetof(quicksand_ringbuffer, reserve) % QUICKSAND_LINE == 0);
+	assert(offsetof(quicksand_ringbuffer, index) % QUICKSAND_LINE == 0);
+	assert(offsetof(quicksand_ringbuffer, updatestamp) % QUICKSAND_LINE == 0);
+	assert(offsetof(quicksand_ringbuffer, min_cursor) % QUICKSAND_LINE == 0);
+	assert(sizeof(quicksand_peer) == QUICKSAND_LINE);
+
+	// segments with another format are refused
+	int fd = shm_open("test_layout", O_CREAT | O_RDWR, 0600);
+	assert(fd >= 0 && ftruncate(fd, sizeof(quicksand_ringbuffer) + 128) == 0);
+	quicksand_ringbuffer *old = mmap(NULL, sizeof(quicksand_ringbuffer),
+					 PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	assert(old != MAP_FAILED);
+	old->length = 2;
+	old->message_size = 64;
+	old->version = QUICKSAND_VERSION;
+	old->magic = 0x1234;
+	quicksand_connection *stale = NULL;
+	assert(quicksand_connect(&stale, "test_layout", -1, -1, -1, NULL) == -EBADMSG);
+	old->magic = QUICKSAND_MAGIC;
+	old->version = QUICKSAND_VERSION - 1;
+	assert(quicksand_connect(&stale, "test_layout", -1, -1, -1, NULL) == -EPROTO);
+	old->version = QUICKSAND_VERSION;
+	old->compat = 1ull << 63; // unknown but compatible
+	assert(quicksand_connect(&stale, "test_layout", -1, -1, -1, NULL) == 0);
+	quicksand_disconnect(&stale, NULL);
+	old->incompat = 1ull << 63;
+	assert(quicksand_connect(&stale, "test_layout", -1, -1, -1, NULL)
+	       == -EPROTONOSUPPORT);
+	munmap(old, sizeof(quicksand_ringbuffer));
+	close(fd);
+	quicksand_delete("test_layout", -1);
+	return 0;
+}
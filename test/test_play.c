@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+#define MESSAGES 100
+
+static char *topics[2] = {"test_play_a", "test_play_b"};
+
+// Read both topics back in order
+static void check(quicksand_connection **readers)
+{
+	int64_t next[2] = {0, 1};
+	int64_t value[16];
+	for(int t = 0; t < 2; t += 1) {
+		int64_t size = sizeof(value);
+		while(quicksand_read(readers[t], (uint8_t *) value, &size) >= 0) {
+			assert(value[0] == next[t]);
+			assert(size == (int64_t) sizeof(int64_t) * (1 + next[t] % 16));
+			next[t] += 2;
+			size = sizeof(value);
+		}
+	}
+	assert(next[0] == MESSAGES && next[1] == MESSAGES + 1);
+}
+
+int main()
+{
+	quicksand_connection *writers[2] = {NULL};
+	quicksand_connection *readers[2] = {NULL};
+	for(int t = 0; t < 2; t += 1) {
+		quicksand_delete(topics[t], -1);
+		assert(quicksand_connect(&writers[t], topics[t], -1, 128, 256, NULL) == 0);
+		assert(quicksand_connect(&readers[t], topics[t], -1, -1, -1, NULL) == 0);
+	}
+
+	// zero-copy writes: reserve, fill in place, commit what was written
+	uint8_t *slot = NULL;
+	int64_t value = 0;
+	int64_t size = sizeof(value);
+	assert(quicksand_reserve(writers[0], &slot, writers[0]->max_payload + 1) == -EMSGSIZE);
+	assert(quicksand_commit(writers[0], 8) == -EINVAL);
+	assert(quicksand_reserve(writers[0], &slot, 64) == 0 && slot);
+	assert(quicksand_reserve(writers[0], &slot, 64) == -EINVAL);
+	assert(quicksand_write(writers[0], (uint8_t *) &value, 8) == -EINVAL);
+	assert(quicksand_read(readers[0], (uint8_t *) &value, &size) == -1);
+	value = 7;
+	memcpy(slot, &value, sizeof(value));
+	assert(quicksand_commit(writers[0], sizeof(value)) == 0);
+	value = 0;
+	assert(quicksand_read(readers[0], (uint8_t *) &value, &size) == 0);
+	assert(value == 7 && size == sizeof(value));
+
+	// a cancelled slot is skipped by readers
+	assert(quicksand_reserve(writers[0], &slot, 64) == 0);
+	assert(quicksand_commit(writers[0], -1) == -ECANCELED);
+	value = 8;
+	assert(quicksand_write(writers[0], (uint8_t *) &value, sizeof(value)) == 0);
+	value = 0;
+	assert(quicksand_read(readers[0], (uint8_t *) &value, &size) == 0);
+	assert(value == 8);
+	assert(quicksand_read(readers[0], (uint8_t *) &value, &size) == -1);
+
+	// record messages 1 ms apart
+	char prefix[64];
+	snprintf(prefix, sizeof(prefix), "/tmp/test_play.%d", (int) getpid());
+	quicksand_recorder *r = NULL;
+	assert(quicksand_record_open(&r, prefix, topics, 2, 0, 1) == 0);
+	int64_t message[16] = {0};
+	uint64_t start = quicksand_now();
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		message[0] = i;
+		assert(quicksand_write(writers[i & 1], (uint8_t *) message,
+				       sizeof(int64_t) * (1 + i % 16)) == 0);
+		assert(quicksand_record_poll(r) >= 0);
+		quicksand_sleep(1e6);
+	}
+	double span = quicksand_ns(quicksand_now(), start);
+	assert(quicksand_record_poll(r) >= 0 && r->records == MESSAGES);
+	quicksand_record_close(&r);
+	for(int t = 0; t < 2; t += 1) {
+		quicksand_disconnect(&readers[t], NULL);
+		quicksand_disconnect(&writers[t], NULL);
+		quicksand_delete(topics[t], -1);
+	}
+
+	// as fast as possible, into topics the player creates
+	quicksand_player *p = NULL;
+	assert(quicksand_play_open(&p, "/tmp/test_play.missing", 0.0, 256) == -ENOENT);
+	assert(quicksand_play_open(&p, prefix, 0.0, 256) == 0);
+	for(int t = 0; t < 2; t += 1) {
+		assert(quicksand_connect(&readers[t], topics[t], -1, -1, -1, NULL) == 0);
+		assert(readers[t]->mask + 1 == 256);
+	}
+	start = quicksand_now();
+	int64_t played = 0;
+	int64_t ret;
+	while((ret = quicksand_play(p, 16)) > 0) {
+		played += ret;
+	}
+	assert(ret == 0 && played == MESSAGES && p->records == MESSAGES && p->skipped == 0);
+	assert(quicksand_ns(quicksand_now(), start) < span / 4.0);
+	quicksand_play_close(&p);
+	check(readers);
+
+	// at twice the recorded speed
+	assert(quicksand_play_open(&p, prefix, 2.0, 256) == 0);
+	start = quicksand_now();
+	assert(quicksand_play(p, 2 * MESSAGES) == MESSAGES);
+	double elapsed = quicksand_ns(quicksand_now(), start);
+	assert(elapsed > span / 2.0 * 0.8 && elapsed < span / 2.0 + 20e6);
+	quicksand_play_close(&p);
+	check(readers);
+
+	// records a topic cannot take are counted, not silently lost
+	quicksand_disconnect(&readers[1], NULL);
+	quicksand_delete(topics[1], -1);
+	assert(quicksand_connect(&readers[1], topics[1], -1, 16, 1, NULL) == 0);
+	int64_t refused = 0;
+	for(int64_t i = 1; i < MESSAGES; i += 2) {
+		refused += (int64_t) sizeof(int64_t) * (1 + i % 16) > readers[1]->max_payload;
+	}
+	assert(refused > 0);
+	assert(quicksand_play_open(&p, prefix, 0.0, 256) == 0);
+	while((ret = quicksand_play(p, 16)) > 0) {
+	}
+	assert(ret == 0 && p->skipped == (uint64_t) refused);
+	assert(p->records + p->skipped == MESSAGES);
+	quicksand_play_close(&p);
+
+	char path[128];
+	snprintf(path, sizeof(path), "%s.000000.qslog", prefix);
+	unlink(path);
+	for(int t = 0; t < 2; t += 1) {
+		quicksand_disconnect(&readers[t], NULL);
+		quicksand_delete(topics[t], -1);
+	}
+}
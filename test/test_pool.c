@@ -0,0 +1,152 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+#define MESSAGES 2000
+#define SIZE(i) (16 + ((i) * 7919) % 300000)
+
+static void fill(uint8_t *data, int64_t i)
+{
+	memset(data, (int) (i & 0xff), SIZE(i));
+	memcpy(data, &i, sizeof(i));
+}
+
+static void check(uint8_t *data, quicksand_blob *blob, int64_t i)
+{
+	int64_t value;
+	memcpy(&value, data, sizeof(value));
+	assert(value == i && blob->length == (uint64_t) SIZE(i));
+	assert(data[SIZE(i) / 2] == (uint8_t) i && data[SIZE(i) - 1] == (uint8_t) i);
+}
+
+// Another process reading every blob through its handle
+static int reader(int ready)
+{
+	quicksand_connection *c = NULL;
+	quicksand_pool *pool = NULL;
+	assert(quicksand_connect(&c, "test_pool", -1, -1, -1, NULL) == 0);
+	assert(quicksand_pool_connect(&pool, "test_pool", -1, -1) == 0);
+	assert(quicksand_register(c) == 0);
+	assert(write(ready, "r", 1) == 1);
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		quicksand_blob blob;
+		uint8_t *data = NULL;
+		int64_t ret;
+		while((ret = quicksand_pool_read(pool, c, &blob, &data)) == -1) {
+			quicksand_wait(c, 1e6);
+		}
+		assert(ret >= 0);
+		check(data, &blob, i);
+		quicksand_pool_release(pool, &blob);
+	}
+	quicksand_pool_close(&pool);
+	quicksand_disconnect(&c, NULL);
+	return 0;
+}
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_pool *pool = NULL;
+	quicksand_pool *other = NULL;
+	quicksand_delete("test_pool", -1);
+	assert(quicksand_pool_connect(&other, "test_pool", -1, -1) == -ENOENT);
+	quicksand_options options = {.ring_length = 8};
+	assert(quicksand_connect_options(&writer, "test_pool", -1, sizeof(quicksand_blob), 1,
+					 &options, NULL) == 0);
+
+	// 4 KiB to 512 KiB classes, attached with or without the geometry
+	assert(quicksand_pool_connect(&pool, "test_pool", 300000, 16) == 0);
+	assert(pool->header->classes == 8 && pool->header->count == 16);
+	assert(quicksand_pool_connect(&other, "test_pool", 300000, 8) == -EINVAL);
+	assert(quicksand_pool_connect(&other, "test_pool", -1, -1) == 0);
+
+	// the ring only carries handles; readers acquire, check and release
+	quicksand_blob blob, got;
+	uint8_t *data = NULL;
+	uint8_t *shared = NULL;
+	assert(quicksand_pool_alloc(pool, 1 << 20, &blob, &data) == -EMSGSIZE);
+	for(int64_t i = 0; i < 64; i += 1) {
+		assert(quicksand_pool_alloc(pool, SIZE(i), &blob, &data) == 0);
+		fill(data, i);
+		assert(quicksand_pool_publish(pool, writer, &blob) == 0);
+		assert(quicksand_pool_read(other, writer, &got, &shared) == 0);
+		check(shared, &got, i);
+		quicksand_pool_release(other, &got);
+	}
+
+	// a held blob survives the ring moving on, an overwritten one is stale
+	quicksand_blob held = blob, stale;
+	assert(quicksand_pool_acquire(other, &held, &shared) == 0);
+	assert(quicksand_pool_alloc(pool, 100, &stale, &data) == 0);
+	assert(quicksand_pool_publish(pool, writer, &stale) == 0);
+	for(int64_t i = 0; i < 40; i += 1) {
+		assert(quicksand_pool_alloc(pool, SIZE(63), &blob, &data) == 0);
+		memset(data, 0, blob.length);
+		assert(quicksand_pool_publish(pool, writer, &blob) == 0);
+		assert(quicksand_pool_alloc(pool, 100, &blob, &data) == 0);
+		assert(quicksand_pool_publish(pool, writer, &blob) == 0);
+	}
+	check(shared, &held, 63);
+	assert(quicksand_pool_acquire(other, &stale, &data) == -ESTALE);
+	quicksand_pool_release(other, &held);
+	quicksand_blob forged = {.offset = 12345, .length = 1};
+	assert(quicksand_pool_acquire(other, &forged, &data) == -EINVAL);
+
+	// blobs that are neither published nor released exhaust their class
+	quicksand_blob taken[16];
+	for(int64_t i = 0; i < 16; i += 1) {
+		assert(quicksand_pool_alloc(other, 5000, &taken[i], &data) == 0);
+	}
+	assert(quicksand_pool_alloc(other, 5000, &blob, &data) == -ENOBUFS);
+	for(int64_t i = 0; i < 16; i += 1) {
+		quicksand_pool_release(other, &taken[i]);
+	}
+
+	// an exhausted class only takes back retained blobs of its own size
+	quicksand_blob small;
+	assert(quicksand_pool_alloc(pool, 100, &small, &data) == 0);
+	assert(quicksand_pool_publish(pool, writer, &small) == 0);
+	for(int64_t i = 0; i < 16; i += 1) {
+		assert(quicksand_pool_alloc(pool, SIZE(63), &taken[i], &data) == 0);
+	}
+	assert(quicksand_pool_alloc(pool, SIZE(63), &blob, &data) == -ENOBUFS);
+	assert(quicksand_pool_acquire(other, &small, &shared) == 0);
+	quicksand_pool_release(other, &small);
+	for(int64_t i = 0; i < 16; i += 1) {
+		quicksand_pool_release(pool, &taken[i]);
+	}
+
+	// a lossless reader in another process sees every blob intact
+	int ready[2];
+	assert(pipe(ready) == 0);
+	pid_t pid = fork();
+	if(pid == 0) {
+		close(ready[0]);
+		_exit(reader(ready[1]));
+	}
+	close(ready[1]);
+	char byte;
+	assert(read(ready[0], &byte, 1) == 1);
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		assert(quicksand_pool_alloc(pool, SIZE(i), &blob, &data) == 0);
+		fill(data, i);
+		assert(quicksand_pool_publish(pool, writer, &blob) == 0);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	quicksand_pool_close(&other);
+	quicksand_pool_close(&pool);
+	assert(!pool);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_pool", -1); // (removes the pool too)
+	assert(quicksand_pool_connect(&pool, "test_pool", -1, -1) == -ENOENT);
+}
@@ -22,17 +22,20 @@ int main()
 
 	int32_t data = 0;
 
-	double delay = 1.0 / rate * 1e9;
+	quicksand_pacer pacer;
+	quicksand_pacer_init(&pacer, (double) rate, QUICKSAND_PACE_CATCHUP);
 
 	while(ok) {
-		uint64_t start = quicksand_now();
 		int64_t ret = quicksand_write(writer, (uint8_t *) &data, sizeof(data));
 		if(ret != 0) {
 			continue;
 		}
 		data = (data + 1) & (32768 - 1); // modulo
-		quicksand_sleep(delay - quicksand_ns(quicksand_now(), start) - 50);
+		quicksand_pace(&pacer);
 	}
+	printf("pacing error: mean %f ns, jitter %f ns, max %f ns\n",
+	       pacer.error_sum_ns / (double) pacer.count,
+	       quicksand_pacer_jitter(&pacer), pacer.error_max_ns);
 
 	quicksand_disconnect(&writer, NULL);
 	quicksand_delete("test_pubsub", -1);
@@ -0,0 +1,108 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+#define MESSAGES 5000
+#define FILE_BYTES (64 * 1024)
+#define CORRUPT 1000 // (a message on the first topic)
+
+int main()
+{
+	char *topics[2] = {"test_record_a", "test_record_b"};
+	quicksand_connection *writers[2] = {NULL};
+	for(int t = 0; t < 2; t += 1) {
+		quicksand_delete(topics[t], -1);
+		assert(quicksand_connect(&writers[t], topics[t], -1, 128, 64, NULL) == 0);
+	}
+	// messages written before the recorder starts are not recorded
+	uint8_t message[128] = {0};
+	assert(quicksand_write(writers[0], message, 8) == 0);
+
+	char prefix[64];
+	snprintf(prefix, sizeof(prefix), "/tmp/test_record.%d", (int) getpid());
+	quicksand_recorder *r = NULL;
+	assert(quicksand_record_open(&r, prefix, topics, 0, 0, 0) == -EINVAL);
+	assert(quicksand_record_open(&r, prefix, topics, 2, FILE_BYTES, 1) == 0);
+	assert(quicksand_record_poll(r) == 0);
+
+	// registered, so nothing is lost as long as we poll within a ring
+	int64_t recorded = 0;
+	for(int64_t i = 0; i < MESSAGES; i += 1) {
+		int64_t length = 8 + i % 113;
+		memset(message, (int) (i & 0xff), sizeof(message));
+		memcpy(message, &i, sizeof(i));
+		assert(quicksand_write(writers[i & 1], message, length) == 0);
+		if(i == CORRUPT) {
+			// a corrupted slot is skipped, not fatal to the recording
+			quicksand_connection *w = writers[0];
+			uint64_t slot = (w->buffer->index - 1) & w->mask;
+			*(int64_t *) (w->data + slot * w->stride + 8) = w->max_payload + 1;
+		}
+		if(i % 32 == 31) {
+			int64_t ret = quicksand_record_poll(r);
+			assert(ret >= 0);
+			recorded += ret;
+		}
+	}
+	recorded += quicksand_record_poll(r);
+	assert(recorded == MESSAGES - 1 && r->records == MESSAGES - 1 && r->dropped == 1);
+	uint64_t files = r->header.segment + 1;
+	assert(files > 2);
+	quicksand_record_close(&r);
+	assert(r == NULL);
+
+	// read everything back
+	int64_t next[2] = {0, 1};
+	uint64_t stamp[2] = {0, 0};
+	uint8_t *data = malloc(2 * FILE_BYTES);
+	for(uint64_t f = 0; f < files; f += 1) {
+		char path[128];
+		snprintf(path, sizeof(path), "%s.%06lu.qslog", prefix, (unsigned long) f);
+		FILE *file = fopen(path, "rb");
+		assert(file);
+		size_t size = fread(data, 1, 2 * FILE_BYTES, file);
+		fclose(file);
+		unlink(path);
+		assert(size <= FILE_BYTES && size > QUICKSAND_LOG_HEADER);
+
+		quicksand_log_header *header = (quicksand_log_header *) data;
+		assert(header->magic == QUICKSAND_LOG_MAGIC);
+		assert(header->version == QUICKSAND_LOG_VERSION);
+		assert(header->segment == f && header->topics == 2);
+		assert(strcmp(header->topic[1].name, "test_record_b") == 0);
+		assert(header->topic[1].message_size >= 128);
+		for(uint64_t t = 0; t < header->topics; t += 1) {
+			assert(header->topic[t].clock.ns_per_tick > 0.0);
+		}
+
+		size_t offset = QUICKSAND_LOG_HEADER;
+		while(offset < size) {
+			quicksand_log_record *record = (quicksand_log_record *) (data + offset);
+			assert(record->topic < 2);
+			next[record->topic] += next[record->topic] == CORRUPT ? 2 : 0;
+			int64_t i = next[record->topic];
+			assert(record->length == (uint32_t) (8 + i % 113));
+			assert(memcmp(record + 1, &i, sizeof(i)) == 0);
+			assert(((uint8_t *) (record + 1))[record->length - 1] == (uint8_t) (i & 0xff)
+			       || record->length == 8);
+			assert(record->stamp >= stamp[record->topic]);
+			stamp[record->topic] = record->stamp;
+			next[record->topic] += 2;
+			offset += sizeof(*record) + ((record->length + 7) & ~7u);
+		}
+		assert(offset == size);
+	}
+	assert(next[0] == MESSAGES && next[1] == MESSAGES + 1);
+	free(data);
+
+	for(int t = 0; t < 2; t += 1) {
+		quicksand_disconnect(&writers[t], NULL);
+		quicksand_delete(topics[t], -1);
+	}
+}
@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_registry", -1);
+	int64_t success1 = quicksand_connect(&writer, "test_registry", -1, 8, 8, NULL);
+	int64_t success2 = quicksand_connect(&reader, "test_registry", -1, -1, -1, NULL);
+	assert(success1 == 0 && writer);
+	assert(success2 == 0 && reader);
+
+	quicksand_peer peers[QUICKSAND_MAX_PEERS];
+	assert(quicksand_peers(writer, peers, QUICKSAND_MAX_PEERS) == 2);
+	assert(peers[0].pid == (uint64_t) getpid());
+	assert(peers[0].role & QUICKSAND_ROLE_WRITER);
+	assert(peers[1].role == QUICKSAND_ROLE_READER);
+
+	// a registered reader that dies without disconnecting
+	pid_t pid = fork();
+	if(pid == 0) {
+		quicksand_connection *child = NULL;
+		quicksand_connect(&child, "test_registry", -1, -1, -1, NULL);
+		_exit(quicksand_register(child) == 0 ? 0 : 1);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	assert(quicksand_peers(writer, peers, QUICKSAND_MAX_PEERS) == 3);
+
+	assert(quicksand_backpressure(writer, QUICKSAND_FAIL, NULL, 0) == 0);
+	int64_t data = 0;
+	for(; data < 8; data += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	}
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == -EAGAIN);
+
+	// once its heartbeat is stale the dead reader is released
+	quicksand_sleep(300e6);
+	quicksand_heartbeat(reader);
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	assert(quicksand_peers(writer, NULL, 0) == 2);
+
+	// a writer that dies between reserving a slot and publishing it
+	quicksand_backpressure(writer, QUICKSAND_LOSSY, NULL, 0);
+	int64_t value = 0, size = sizeof(value);
+	while(quicksand_read(reader, (uint8_t *) &value, &size) >= 0) {}
+	pid = fork();
+	if(pid == 0) {
+		_exit(0);
+	}
+	waitpid(pid, &status, 0);
+	quicksand_ringbuffer *rb = writer->buffer;
+	uint64_t dead = atomic_fetch_add(&rb->reserve, 1);
+	uint8_t *slot = (uint8_t *) rb + ((sizeof(quicksand_ringbuffer) + 63) & ~63ul)
+			+ (dead & (rb->length - 1)) * rb->message_size;
+	*(uint64_t *) (slot + 16) = (dead << 32) | (uint64_t) pid;
+
+	uint64_t start = quicksand_now();
+	data = 42;
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	assert(quicksand_ns(quicksand_now(), start) < 10e6);
+	assert(*(uint64_t *) (slot + 16) == dead << 32); // claimed by the recoverer
+	assert(quicksand_read(reader, (uint8_t *) &value, &size) == 0);
+	assert(value == 42);
+
+	// readers record the largest lag they observed
+	quicksand_connection *lagging = NULL;
+	assert(quicksand_connect(&lagging, "test_registry", -1, -1, -1, NULL) == 0);
+	assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	assert(quicksand_read(lagging, (uint8_t *) &value, &size) == 0);
+	for(data = 0; data < 3; data += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	}
+	assert(quicksand_read(lagging, (uint8_t *) &value, &size) == 2);
+	assert(lagging->buffer->peers[lagging->peer_slot].lag == 3);
+	quicksand_disconnect(&lagging, NULL);
+
+	quicksand_disconnect(&reader, NULL);
+	assert(quicksand_peers(writer, NULL, 0) == 1);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_registry", -1);
+	return 0;
+}
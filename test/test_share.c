@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "quicksand.h"
+
+#define READERS 16
+
+// Number of mappings of a topic in this process
+static int mappings(const char *topic)
+{
+	FILE *maps = fopen("/proc/self/maps", "r");
+	assert(maps);
+	char line[512];
+	int count = 0;
+	while(fgets(line, sizeof(line), maps)) {
+		count += strstr(line, topic) != NULL;
+	}
+	fclose(maps);
+	return count;
+}
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *readers[READERS] = {NULL};
+	quicksand_delete("test_share", -1);
+	assert(quicksand_connect(&writer, "test_share", -1, 8, 64, NULL) == 0);
+	for(int i = 0; i < READERS; i += 1) {
+		assert(quicksand_connect(&readers[i], "test_share", -1, -1, -1, NULL) == 0);
+		assert(readers[i]->buffer == writer->buffer);
+	}
+	assert(mappings("test_share") == 1);
+
+	// each connection keeps its own cursor
+	for(int64_t data = 0; data < 3; data += 1) {
+		assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+	}
+	int64_t value = 0;
+	int64_t size = sizeof(value);
+	for(int64_t i = 0; i < 3; i += 1) {
+		size = sizeof(value);
+		assert(quicksand_read(readers[0], (uint8_t *) &value, &size) >= 0);
+		assert(value == i);
+	}
+	size = sizeof(value);
+	assert(quicksand_read(readers[0], (uint8_t *) &value, &size) == -1);
+	size = sizeof(value);
+	assert(quicksand_read(readers[1], (uint8_t *) &value, &size) == 2);
+	assert(value == 0);
+
+	// the mapping lives until its last connection disconnects
+	quicksand_disconnect(&writer, NULL);
+	for(int i = 1; i < READERS; i += 1) {
+		quicksand_disconnect(&readers[i], NULL);
+	}
+	assert(mappings("test_share") == 1);
+	size = sizeof(value);
+	assert(quicksand_read(readers[0], (uint8_t *) &value, &size) == -1);
+	quicksand_disconnect(&readers[0], NULL);
+	assert(mappings("test_share") == 0);
+
+	// a deleted and re-created topic is not served from the old mapping
+	assert(quicksand_connect(&writer, "test_share", -1, 8, 64, NULL) == 0);
+	quicksand_delete("test_share", -1);
+	assert(quicksand_connect(&readers[0], "test_share", -1, 8, 64, NULL) == 0);
+	assert(readers[0]->buffer != writer->buffer);
+	assert(mappings("test_share") == 2);
+
+	quicksand_disconnect(&readers[0], NULL);
+	quicksand_disconnect(&writer, NULL);
+	assert(mappings("test_share") == 0);
+	quicksand_delete("test_share", -1);
+}
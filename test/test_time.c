@@ -8,7 +8,27 @@
 
 int main(void)
 {
-	quicksand_ns_calibrate(1e6); // 1 millisecond
+	// calibrated when the library loads: the first conversion does not stall
+	uint64_t first = quicksand_now();
+	assert(quicksand_ns(quicksand_now(), first) < 100e3);
+	assert(quicksand_clock_invariant() == 0 || quicksand_clock_invariant() == 1);
+
+	double ns_per_tick = quicksand_ns_calibrate(1e6); // 1 millisecond
+	double synced = quicksand_clock_sync();
+	assert(fabs(synced - ns_per_tick) < 0.01 * ns_per_tick);
+	assert(quicksand_clock_discipline(100e6) == 0);
+
+	// fixed-point conversion agrees with the floating point one
+	uint64_t stamps[64], ns[64];
+	for(int i = 0; i < 64; i += 1) {
+		stamps[i] = first + (uint64_t) i * 123456789ull * (uint64_t) i;
+	}
+	quicksand_ticks_ns_array(stamps, ns, 64, first);
+	for(int i = 0; i < 64; i += 1) {
+		double expected = quicksand_ns(stamps[i], first);
+		assert(fabs((double) ns[i] - expected) <= 1.0 + expected * 1e-9);
+		assert(ns[i] == quicksand_ticks_ns(stamps[i] - first));
+	}
 
 	double mean = 0.0;
 	double mean_unix = 0.0;
@@ -44,4 +64,76 @@ int main(void)
 
 	assert(fabs(mean - mean_unix) < 1000.0);
 	assert(mean_unix < 15e3);
+
+	// shared calibration: slot stamps map onto the system clocks in every
+	// process that attaches to the topic
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_clock", -1);
+	assert(quicksand_connect(&writer, "test_clock", -1, 8, 16, NULL) == 0);
+	assert(quicksand_connect(&reader, "test_clock", -1, -1, -1, NULL) == 0);
+	assert(writer->buffer->clock.ns_per_tick > 0.0);
+	assert(quicksand_clock_adopt(reader) == 0);
+
+	for(int i = 0; i < 3; i += 1) {
+		struct timespec mono_ts, real_ts;
+		clock_gettime(CLOCK_MONOTONIC, &mono_ts);
+		clock_gettime(CLOCK_REALTIME, &real_ts);
+		uint64_t stamp = quicksand_now();
+		double mono = (double) mono_ts.tv_sec * 1e9 + (double) mono_ts.tv_nsec;
+		double real = (double) real_ts.tv_sec * 1e9 + (double) real_ts.tv_nsec;
+		assert(fabs((double) quicksand_stamp_monotonic(reader, stamp) - mono) < 50e3);
+		assert(fabs((double) quicksand_stamp_realtime(reader, stamp) - real) < 50e3);
+		assert(quicksand_stamp_realtime(reader, stamp)
+		       == quicksand_stamp_realtime(writer, stamp));
+		quicksand_clock_update(writer);
+	}
+	assert(writer->buffer->clock.sequence % 2 == 0);
+
+	// an update left half done by a dead process neither hangs readers
+	// nor blocks the next update
+	quicksand_clock *clock = &writer->buffer->clock;
+	uint64_t sequence = clock->sequence;
+	clock->sequence = sequence + 1;
+	clock->claimed = 1;
+	uint64_t before = quicksand_now();
+	assert(quicksand_stamp_monotonic(reader, before) == 0); // (unpublished)
+	assert(quicksand_ns(quicksand_now(), before) < 10e6);
+	quicksand_clock_update(writer);
+	assert(clock->sequence == sequence + 4 && clock->claimed == 0);
+	assert(quicksand_stamp_monotonic(reader, quicksand_now()) > 0);
+
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_clock", -1);
+
+	// pacing: absolute deadlines keep the average rate exact
+	quicksand_pacer pacer;
+	assert(quicksand_pacer_init(&pacer, 0.0, QUICKSAND_PACE_DROP) == -1);
+	assert(quicksand_pacer_init(&pacer, 20e3, 7) == -1);
+	assert(quicksand_pacer_init(&pacer, 20e3, QUICKSAND_PACE_CATCHUP) == 0);
+	start = quicksand_now();
+	for(int i = 0; i < 200; i += 1) {
+		quicksand_pace(&pacer);
+	}
+	double paced = quicksand_ns(quicksand_now(), pacer.start);
+	assert(fabs(paced - 200 * 50e3) < 200e3);
+	assert(pacer.count == 200 && pacer.missed == 0);
+	assert(pacer.error_sum_ns / 200.0 >= 0.0);
+
+	// overruns are released back to back, or dropped
+	quicksand_sleep(200e3);
+	assert(quicksand_pace(&pacer) >= 2);
+	assert(pacer.missed == 0);
+	assert(quicksand_pacer_init(&pacer, 20e3, QUICKSAND_PACE_DROP) == 0);
+	quicksand_sleep(200e3);
+	int64_t skipped = quicksand_pace(&pacer);
+	assert(skipped >= 2 && pacer.missed == (uint64_t) skipped);
+	assert(pacer.error_ns < 50e3);
+	assert(quicksand_pace(&pacer) == 0 && pacer.error_ns < 50e3);
+
+	// the busy-wait window is configurable (0 only sleeps)
+	assert(quicksand_pacer_spin(&pacer, -1.0) == -1);
+	assert(quicksand_pacer_spin(&pacer, 0.0) == 0);
+	assert(quicksand_pace(&pacer) >= 0 && pacer.error_ns >= 0.0);
 }
@@ -0,0 +1,65 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "quicksand.h"
+
+typedef struct {
+	double x, y, yaw;
+	uint64_t stamp;
+} pose;
+
+typedef struct {
+	float x, y, yaw;
+	uint64_t stamp;
+} pose_v2; // the same fields, another layout
+
+int main()
+{
+	uint64_t type = QUICKSAND_TYPE_HASH(pose);
+	assert(type != 0 && type == quicksand_type_hash("pose", sizeof(pose)));
+	assert(type != QUICKSAND_TYPE_HASH(pose_v2));
+	assert(type != quicksand_type_hash("pose", sizeof(pose_v2)));
+
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_type", -1);
+	quicksand_options options = {.ring_length = 16, .type = type};
+	assert(quicksand_connect_options(&writer, "test_type", -1, sizeof(pose), 1, &options,
+					 NULL) == 0);
+	assert(writer->buffer->type == type && (writer->buffer->compat & QUICKSAND_COMPAT_TYPE));
+	quicksand_topic_info info;
+	assert(quicksand_directory_find("test_type", &info) == 0 && info.type == type);
+
+	// matching and untyped peers connect, mismatched ones are refused
+	assert(quicksand_connect_options(&reader, "test_type", -1, -1, -1, &options, NULL) == 0);
+	quicksand_disconnect(&reader, NULL);
+	assert(quicksand_connect(&reader, "test_type", -1, -1, -1, NULL) == 0);
+	quicksand_disconnect(&reader, NULL);
+	options.type = QUICKSAND_TYPE_HASH(pose_v2);
+	assert(quicksand_connect_options(&reader, "test_type", -1, -1, -1, &options, NULL)
+	       == -EPROTOTYPE);
+	assert(reader == NULL);
+	quicksand_connection *other = NULL;
+	assert(quicksand_connect_options(&other, "test_type", -1, sizeof(pose), 1, &options, NULL)
+	       == -EPROTOTYPE);
+
+	// growth keeps the type
+	assert(quicksand_grow(writer, 2 * sizeof(pose), 32) == 0);
+	assert(writer->buffer->type == type);
+	assert(quicksand_connect_options(&reader, "test_type", -1, -1, -1, &options, NULL)
+	       == -EPROTOTYPE);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_type", -1);
+
+	// untyped topics accept any type
+	options.type = 0;
+	assert(quicksand_connect_options(&writer, "test_type", -1, sizeof(pose), 1, &options,
+					 NULL) == 0);
+	assert(writer->buffer->type == 0 && !(writer->buffer->compat & QUICKSAND_COMPAT_TYPE));
+	options.type = type;
+	assert(quicksand_connect_options(&reader, "test_type", -1, -1, -1, &options, NULL) == 0);
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_type", -1);
+}
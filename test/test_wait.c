@@ -0,0 +1,82 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "quicksand.h"
+
+static double seconds(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+int main()
+{
+	quicksand_connection *writer = NULL;
+	quicksand_connection *reader = NULL;
+	quicksand_delete("test_wait", -1);
+	int64_t success1 = quicksand_connect(&writer, "test_wait", -1, 8, 64, NULL);
+	int64_t success2 = quicksand_connect(&reader, "test_wait", -1, -1, -1, NULL);
+	assert(success1 == 0 && writer);
+	assert(success2 == 0 && reader);
+
+	assert(quicksand_wait_policy(reader, -1.0, 0.0, 0.0) == -EINVAL);
+	assert(quicksand_wait_policy(reader, 0.0, 0.0, 1e9) == -EINVAL);
+	assert(quicksand_wait_policy(reader, 5e3, 0.0, 0.0) == 0);
+	assert(reader->wait_spin_ns == 5e3 && reader->wait_yield_ns == 100e3);
+
+	// an idle topic times out without keeping the core busy
+	double wall = seconds(CLOCK_MONOTONIC);
+	double cpu = seconds(CLOCK_PROCESS_CPUTIME_ID);
+	assert(quicksand_wait(reader, 50e6) == -ETIMEDOUT);
+	wall = seconds(CLOCK_MONOTONIC) - wall;
+	cpu = seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+	assert(wall >= 50e-3 && wall < 250e-3);
+	assert(cpu < wall / 2.0);
+
+	// a sleeping reader is woken by a write from another process
+	pid_t pid = fork();
+	if(pid == 0) {
+		quicksand_connection *child = NULL;
+		quicksand_connect(&child, "test_wait", -1, 8, 64, NULL);
+		quicksand_sleep(20e6);
+		int64_t data = 42;
+		_exit(quicksand_write(child, (uint8_t *) &data, sizeof(data)) == 0 ? 0 : 1);
+	}
+	wall = seconds(CLOCK_MONOTONIC);
+	assert(quicksand_wait(reader, 1e9) == 0);
+	wall = seconds(CLOCK_MONOTONIC) - wall;
+	assert(wall < 500e-3);
+	int64_t value = 0;
+	int64_t size = sizeof(value);
+	assert(quicksand_read(reader, (uint8_t *) &value, &size) == 0);
+	assert(value == 42);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	// ready messages return at once, and the reader learns their spacing
+	for(int64_t batch = 0; batch < 4; batch += 1) {
+		for(int64_t data = 0; data < 16; data += 1) {
+			assert(quicksand_write(writer, (uint8_t *) &data, sizeof(data)) == 0);
+			quicksand_sleep(20e3);
+		}
+		for(int64_t i = 0; i < 16; i += 1) {
+			assert(quicksand_wait(reader, 0.0) == 0);
+			size = sizeof(value);
+			assert(quicksand_read(reader, (uint8_t *) &value, &size) >= 0);
+			assert(value == i);
+		}
+	}
+	assert(quicksand_wait(reader, 0.0) == -ETIMEDOUT);
+	assert(reader->arrival_ns > 10e3 && reader->arrival_ns < 1e6);
+
+	quicksand_disconnect(&reader, NULL);
+	quicksand_disconnect(&writer, NULL);
+	quicksand_delete("test_wait", -1);
+}
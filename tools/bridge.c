@@ -0,0 +1,140 @@
+// -------------------------------------------------------------------------
+// bridge.c – extend topics to another host
+// -------------------------------------------------------------------------
+//
+// Usage: quicksand-bridge recv <port> [prefix]
+//        quicksand-bridge [-l] send <host> <port> <topic>...
+//
+// The receiving side accepts any number of senders and republishes each
+// topic into a mirror topic (named prefix + topic) with the same geometry.
+// The sending side opens one TCP stream per topic and forwards every
+// message written after it started; with -l it is a lossless reader, so
+// local writers wait for the network instead of the bridge dropping.
+// -------------------------------------------------------------------------
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "quicksand.h"
+
+#define BRIDGES 64
+
+static volatile int ok = 1;
+
+void interrupt()
+{
+	ok = 0;
+}
+
+static void report(quicksand_bridge *b)
+{
+	printf("%s: %lu messages, %.1f MiB in %lu batches, %lu dropped\n",
+	       (char *) b->topic->name, (unsigned long) b->messages,
+	       (double) b->bytes / (1024.0 * 1024.0), (unsigned long) b->sends,
+	       (unsigned long) b->dropped);
+}
+
+static int receive(int64_t port, char *prefix)
+{
+	int64_t listener = quicksand_bridge_listen(NULL, port);
+	if(listener < 0) {
+		fprintf(stderr, "cannot listen on %ld (%ld)\n", (long) port, (long) listener);
+		return 1;
+	}
+	quicksand_bridge *bridges[BRIDGES] = {NULL};
+	int64_t count = 0;
+	while(ok) {
+		struct pollfd fds[BRIDGES + 1];
+		fds[0] = (struct pollfd){.fd = (int) listener, .events = POLLIN};
+		for(int64_t i = 0; i < count; i += 1) {
+			fds[i + 1] = (struct pollfd){.fd = (int) bridges[i]->fd, .events = POLLIN};
+		}
+		if(poll(fds, (nfds_t) count + 1, 100) <= 0) {
+			continue;
+		}
+		if((fds[0].revents & POLLIN) && count < BRIDGES) {
+			int64_t ret = quicksand_bridge_accept(&bridges[count], listener, prefix);
+			if(ret == 0) {
+				printf("mirroring %s\n", (char *) bridges[count]->topic->name);
+				count += 1;
+			} else {
+				fprintf(stderr, "rejected a sender (%ld)\n", (long) ret);
+			}
+		}
+		for(int64_t i = 0; i < count; i += 1) {
+			if(!fds[i + 1].revents) {
+				continue;
+			}
+			int64_t ret;
+			while((ret = quicksand_bridge_poll(bridges[i])) > 0) {
+			}
+			if(ret < 0) { // sender went away
+				report(bridges[i]);
+				quicksand_bridge_close(&bridges[i]);
+				bridges[i] = bridges[--count];
+				bridges[count] = NULL;
+				break; // (fds no longer match)
+			}
+		}
+	}
+	for(int64_t i = 0; i < count; i += 1) {
+		report(bridges[i]);
+		quicksand_bridge_close(&bridges[i]);
+	}
+	return 0;
+}
+
+static int transmit(char *host, int64_t port, char **topics, int64_t count, int64_t reliable)
+{
+	quicksand_bridge *bridges[BRIDGES] = {NULL};
+	count = count < BRIDGES ? count : BRIDGES;
+	for(int64_t i = 0; i < count; i += 1) {
+		int64_t ret = quicksand_bridge_send(&bridges[i], topics[i], host, port, reliable);
+		if(ret != 0) {
+			fprintf(stderr, "cannot bridge %s (%ld)\n", topics[i], (long) ret);
+			count = i;
+			ok = 0;
+		}
+	}
+	while(ok && count) {
+		int64_t moved = 0;
+		for(int64_t i = 0; i < count && ok; i += 1) {
+			int64_t ret = quicksand_bridge_poll(bridges[i]);
+			if(ret < 0) {
+				fprintf(stderr, "bridge stopped (%ld)\n", (long) ret);
+				ok = 0;
+			}
+			moved += ret > 0 ? ret : 0;
+		}
+		if(!moved) {
+			quicksand_wait(bridges[0]->topic, 50e3);
+		}
+	}
+	for(int64_t i = 0; i < count; i += 1) {
+		report(bridges[i]);
+		quicksand_bridge_close(&bridges[i]);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int64_t reliable = argc > 1 && strcmp(argv[1], "-l") == 0;
+	int arg = 1 + (int) reliable;
+	signal(SIGINT, interrupt);
+	signal(SIGTERM, interrupt);
+	if(argc - arg >= 2 && strcmp(argv[arg], "recv") == 0) {
+		return receive(atoll(argv[arg + 1]), argc - arg > 2 ? argv[arg + 2] : NULL);
+	}
+	if(argc - arg >= 4 && strcmp(argv[arg], "send") == 0) {
+		return transmit(argv[arg + 1], atoll(argv[arg + 2]), argv + arg + 3,
+				argc - arg - 3, reliable);
+	}
+	fprintf(stderr, "usage: %s recv <port> [prefix]\n"
+			"       %s [-l] send <host> <port> <topic>...\n",
+		argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,73 @@
+// -------------------------------------------------------------------------
+// play.c – republish recorded topics
+// -------------------------------------------------------------------------
+//
+// Usage: quicksand-play [-x speed] [-r slots] <prefix>
+//
+// Plays <prefix>.000000.qslog, <prefix>.000001.qslog... (written by
+// quicksand-record) back into the recorded topics with the recorded
+// message spacing divided by -x (default 1, 0 as fast as possible).
+// Missing topics are created with -r slots (default 1024).
+// -------------------------------------------------------------------------
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "quicksand.h"
+
+static volatile int ok = 1;
+
+void interrupt()
+{
+	ok = 0;
+}
+
+int main(int argc, char **argv)
+{
+	double speed = 1.0;
+	int64_t slots = 1024;
+	int arg = 1;
+	for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+		if(strcmp(argv[arg], "-x") == 0) {
+			speed = atof(argv[arg + 1]);
+		} else if(strcmp(argv[arg], "-r") == 0) {
+			slots = atoll(argv[arg + 1]);
+		} else {
+			break;
+		}
+	}
+	if(argc - arg != 1 || speed < 0.0 || slots < 1) {
+		fprintf(stderr, "usage: %s [-x speed] [-r slots] <prefix>\n", argv[0]);
+		return 1;
+	}
+	signal(SIGINT, interrupt);
+
+	quicksand_player *p = NULL;
+	int64_t ret = quicksand_play_open(&p, argv[arg], speed, slots);
+	if(ret != 0) {
+		fprintf(stderr, "cannot play %s (%ld)\n", argv[arg], (long) ret);
+		return 1;
+	}
+
+	uint64_t start = quicksand_now();
+	while(ok) {
+		ret = quicksand_play(p, 64);
+		if(ret == -EAGAIN || ret == -ETIMEDOUT) {
+			continue; // a lossless reader is behind
+		}
+		if(ret <= 0) {
+			break;
+		}
+	}
+	if(ret < 0) {
+		fprintf(stderr, "playback stopped (%ld)\n", (long) ret);
+	}
+	double seconds = quicksand_ns(quicksand_now(), start) * 1e-9;
+	printf("%lu messages, %.1f MiB in %.1f s (%lu skipped)\n", (unsigned long) p->records,
+	       (double) p->bytes / (1024.0 * 1024.0), seconds, (unsigned long) p->skipped);
+	quicksand_play_close(&p);
+	return ret < 0;
+}
@@ -0,0 +1,74 @@
+// -------------------------------------------------------------------------
+// record.c – record topics to disk until interrupted
+// -------------------------------------------------------------------------
+//
+// Usage: quicksand-record [-s MiB] [-l] <prefix> <topic>...
+//
+// Writes every message published on the topics after startup to
+// <prefix>.000000.qslog, <prefix>.000001.qslog... starting a new file every
+// -s MiB (default 1024, 0 for a single file).  With -l the recorder
+// registers as a lossless reader so writers wait for it instead of
+// overwriting messages it has not saved yet.
+// -------------------------------------------------------------------------
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "quicksand.h"
+
+static volatile int ok = 1;
+
+void interrupt()
+{
+	ok = 0;
+}
+
+int main(int argc, char **argv)
+{
+	int64_t megabytes = 1024;
+	int64_t reliable = 0;
+	int arg = 1;
+	for(; arg < argc && argv[arg][0] == '-'; arg += 1) {
+		if(strcmp(argv[arg], "-l") == 0) {
+			reliable = 1;
+		} else if(strcmp(argv[arg], "-s") == 0 && arg + 1 < argc) {
+			megabytes = atoll(argv[++arg]);
+		} else {
+			break;
+		}
+	}
+	if(argc - arg < 2 || megabytes < 0) {
+		fprintf(stderr, "usage: %s [-s MiB] [-l] <prefix> <topic>...\n", argv[0]);
+		return 1;
+	}
+	signal(SIGINT, interrupt);
+	signal(SIGTERM, interrupt);
+
+	quicksand_recorder *r = NULL;
+	int64_t ret = quicksand_record_open(&r, argv[arg], argv + arg + 1, argc - arg - 1,
+					    megabytes * 1024 * 1024, reliable);
+	if(ret != 0) {
+		fprintf(stderr, "cannot record %s (%ld)\n", argv[arg + 1], (long) ret);
+		return 1;
+	}
+
+	uint64_t start = quicksand_now();
+	while(ok) {
+		ret = quicksand_record_poll(r);
+		if(ret < 0) {
+			fprintf(stderr, "recording stopped (%ld)\n", (long) ret);
+			break;
+		}
+		if(ret == 0) {
+			quicksand_wait(r->topics[0], 50e3);
+		}
+	}
+	double seconds = quicksand_ns(quicksand_now(), start) * 1e-9;
+	printf("%lu messages, %.1f MiB in %lu files over %.1f s (%lu corrupted skipped)\n",
+	       (unsigned long) r->records, (double) r->bytes / (1024.0 * 1024.0),
+	       (unsigned long) r->header.segment + 1, seconds, (unsigned long) r->dropped);
+	quicksand_record_close(&r);
+	return ret < 0;
+}
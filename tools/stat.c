@@ -0,0 +1,109 @@
+// -------------------------------------------------------------------------
+// stat.c – report topic geometry and the reader lag actually observed
+// -------------------------------------------------------------------------
+//
+// Usage: quicksand-stat [<topic> [seconds]]
+//
+// Without a topic, lists the topics in the directory.
+// Attaches to a topic without registering as a reader, then prints the
+// write rate and, for every connected peer, the largest number of unread
+// slots it has seen.  Lossy readers skip once they fall half a ring
+// behind, so the suggested ring length is twice the worst observed lag.
+// -------------------------------------------------------------------------
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "quicksand.h"
+
+static volatile int ok = 1;
+
+void interrupt()
+{
+	ok = 0;
+}
+
+static int list(void)
+{
+	static quicksand_topic_info topics[QUICKSAND_DIRECTORY_SLOTS];
+	int64_t count = quicksand_directory_list(topics, QUICKSAND_DIRECTORY_SLOTS);
+	if(count < 0) {
+		fprintf(stderr, "cannot open the topic directory (%ld)\n", (long) count);
+		return 1;
+	}
+	for(int64_t i = 0; i < count; i += 1) {
+		quicksand_topic_info *t = &topics[i];
+		time_t created = (time_t) (t->created_ns / 1000000000ull);
+		char when[32];
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&created));
+		printf("%-32s %8lu slots x %-8lu bytes  gen %lu  type %016lx  pid %-8lu %s\n",
+		       t->name, (unsigned long) t->length, (unsigned long) t->message_size,
+		       (unsigned long) t->generation, (unsigned long) t->type,
+		       (unsigned long) t->pid, when);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 2) {
+		return list();
+	}
+	signal(SIGINT, interrupt);
+	int64_t seconds = argc > 2 ? atoll(argv[2]) : -1;
+
+	quicksand_connection *c = NULL;
+	int64_t ret = quicksand_connect(&c, argv[1], -1, -1, -1, NULL);
+	if(ret != 0) {
+		fprintf(stderr, "cannot connect to %s (%ld)\n", argv[1], (long) ret);
+		return 1;
+	}
+	quicksand_ringbuffer *rb = c->buffer;
+	printf("%s: %lu slots x %lu bytes (%.1f MiB)\n", argv[1],
+	       (unsigned long) rb->length, (unsigned long) rb->message_size,
+	       (double) c->shared_memory_size / (1024.0 * 1024.0));
+
+	quicksand_peer peers[QUICKSAND_MAX_PEERS];
+	uint64_t last_index = rb->index;
+	uint64_t last_stamp = quicksand_now();
+	while(ok && seconds != 0) {
+		quicksand_sleep(1e9);
+		seconds -= seconds > 0;
+
+		uint64_t index = rb->index;
+		uint64_t stamp = quicksand_now();
+		double rate = (double) (index - last_index) / (quicksand_ns(stamp, last_stamp) * 1e-9);
+		last_index = index;
+		last_stamp = stamp;
+
+		int64_t count = quicksand_peers(c, peers, QUICKSAND_MAX_PEERS);
+		uint64_t worst = 0;
+		printf("%.0f msgs/s, %ld peers\n", rate, (long) count - 1);
+		for(int64_t i = 0; i < count && i < QUICKSAND_MAX_PEERS; i += 1) {
+			if(peers[i].pid == c->pid) {
+				continue; // ourselves
+			}
+			uint64_t lag = peers[i].lag;
+			worst = lag > worst ? lag : worst;
+			printf("  pid %-8lu %s%s%s max lag %lu slots (%.3f ms)\n",
+			       (unsigned long) peers[i].pid,
+			       peers[i].role & QUICKSAND_ROLE_WRITER ? "W" : "-",
+			       peers[i].role & QUICKSAND_ROLE_READER ? "R" : "-",
+			       peers[i].role & QUICKSAND_ROLE_RELIABLE ? "L" : "-",
+			       (unsigned long) lag,
+			       rate > 0.0 ? (double) lag / rate * 1e3 : 0.0);
+		}
+		uint64_t suggested = 2;
+		while(suggested < 2 * worst) {
+			suggested <<= 1;
+		}
+		printf("  suggested ring_length %lu (%.1f MiB)\n", (unsigned long) suggested,
+		       (double) (suggested * rb->message_size) / (1024.0 * 1024.0));
+		fflush(stdout);
+	}
+
+	quicksand_disconnect(&c, NULL);
+	return 0;
+}